@@ -0,0 +1,138 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <GL/glew.h>
+#include "GLState.h"
+#include "Shader.h"
+#include "RenderStats.h"
+#include "RenderTarget.h"
+
+
+class AutoExposure {
+	static const int LUMINANCE_SIZE = 64;
+
+	bool adapted = false;
+	int current = 0, count_levels = 0;
+	double adaptation_speed = 1.5;
+	unsigned int luminance_texture = 0, luminance_framebuffer = 0;
+	unsigned int adapted_textures[2] = { 0, 0 }, adapted_framebuffers[2] = { 0, 0 };
+	std::chrono::steady_clock::time_point last_update;
+
+	void create_texture(unsigned int& texture, unsigned int& framebuffer, GLenum format, int size) {
+		glGenTextures(1, &texture);
+		gl_state.bind_texture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, size, size, 0, GL_RED, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, size > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glGenFramebuffers(1, &framebuffer);
+		gl_state.bind_framebuffer(framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::AUTO_EXPOSURE::CREATE\nFramebuffer is not complete.\n";
+	}
+
+	double get_adaptation() {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double time = std::chrono::duration < double >(now - last_update).count();
+		last_update = now;
+
+		if (!adapted) {
+			adapted = true;
+			return 1;
+		}
+		return 1 - exp(-time * adaptation_speed);
+	}
+
+public:
+	void create() {
+		if (luminance_texture != 0)
+			return;
+
+		create_texture(luminance_texture, luminance_framebuffer, GL_R16F, LUMINANCE_SIZE);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		float luminance = 1;
+		for (int i = 0; i < 2; i++) {
+			create_texture(adapted_textures[i], adapted_framebuffers[i], GL_R32F, 1);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RED, GL_FLOAT, &luminance);
+		}
+
+		count_levels = (int)round(log2(LUMINANCE_SIZE)) + 1;
+		current = 0;
+		adapted = false;
+	}
+
+	void set_adaptation_speed(double adaptation_speed) {
+		this->adaptation_speed = std::max(adaptation_speed, 0.0);
+	}
+
+	void reset() {
+		adapted = false;
+	}
+
+	void update(RenderTarget& render_target, Shader* exposure_shader, unsigned int screen_coord_vao) {
+		create();
+
+		exposure_shader->use();
+		unsigned int program = exposure_shader->program;
+		gl_state.set_capability(GL_DEPTH_TEST, false);
+		gl_state.set_capability(GL_STENCIL_TEST, false);
+		gl_state.set_capability(GL_BLEND, false);
+		gl_state.bind_vertex_array(screen_coord_vao);
+
+		gl_state.bind_framebuffer(luminance_framebuffer);
+		glViewport(0, 0, LUMINANCE_SIZE, LUMINANCE_SIZE);
+		gl_state.bind_texture_unit(0, GL_TEXTURE_2D, render_target.tex_color_buffer);
+		glUniform1i(glGetUniformLocation(program, "stage"), 0);
+		glUniform2f(glGetUniformLocation(program, "luminance_size"), LUMINANCE_SIZE, LUMINANCE_SIZE);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+		gl_state.bind_texture(GL_TEXTURE_2D, luminance_texture);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		gl_state.bind_framebuffer(adapted_framebuffers[1 - current]);
+		glViewport(0, 0, 1, 1);
+		gl_state.bind_texture_unit(1, GL_TEXTURE_2D, luminance_texture);
+		gl_state.bind_texture_unit(2, GL_TEXTURE_2D, adapted_textures[current]);
+		glUniform1i(glGetUniformLocation(program, "stage"), 1);
+		glUniform1i(glGetUniformLocation(program, "luminance_level"), count_levels - 1);
+		glUniform1f(glGetUniformLocation(program, "adaptation"), get_adaptation());
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		current = 1 - current;
+
+		frame_counters.uniform_uploads += 6;
+		frame_counters.draw_calls += 2;
+		frame_counters.instances += 2;
+		frame_counters.triangles += 4;
+
+		gl_state.bind_texture_unit(0, GL_TEXTURE_2D, 0);
+		gl_state.bind_texture_unit(1, GL_TEXTURE_2D, 0);
+		gl_state.bind_texture_unit(2, GL_TEXTURE_2D, 0);
+		gl_state.set_capability(GL_DEPTH_TEST, true);
+		gl_state.set_capability(GL_STENCIL_TEST, true);
+		gl_state.set_capability(GL_BLEND, true);
+	}
+
+	unsigned int get_texture() {
+		return adapted_textures[current];
+	}
+
+	void destroy() {
+		if (luminance_texture == 0)
+			return;
+
+		gl_state.delete_framebuffer(luminance_framebuffer);
+		gl_state.delete_texture(luminance_texture);
+		for (int i = 0; i < 2; i++) {
+			gl_state.delete_framebuffer(adapted_framebuffers[i]);
+			gl_state.delete_texture(adapted_textures[i]);
+			adapted_textures[i] = adapted_framebuffers[i] = 0;
+		}
+		luminance_texture = luminance_framebuffer = 0;
+	}
+};
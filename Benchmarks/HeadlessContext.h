@@ -0,0 +1,92 @@
+#pragma once
+
+#include <iostream>
+
+#ifndef EGL_NO_X11
+#define EGL_NO_X11
+#endif
+#ifndef MESA_EGL_NO_X11_HEADERS
+#define MESA_EGL_NO_X11_HEADERS
+#endif
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+
+class HeadlessContext {
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLSurface surface = EGL_NO_SURFACE;
+	EGLContext context = EGL_NO_CONTEXT;
+
+	EGLDisplay get_display() {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display != nullptr) {
+			EGLDisplay surfaceless = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (surfaceless != EGL_NO_DISPLAY)
+				return surfaceless;
+		}
+		return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+public:
+	bool create(int width, int height) {
+		display = get_display();
+		EGLint major, minor;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+			std::cout << "ERROR::HEADLESS_CONTEXT::CREATE\nFailed to initialize EGL display.\n";
+			return false;
+		}
+
+		EGLint config_attributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8,
+			EGL_GREEN_SIZE, 8,
+			EGL_BLUE_SIZE, 8,
+			EGL_DEPTH_SIZE, 24,
+			EGL_STENCIL_SIZE, 8,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint count_configs = 0;
+		if (!eglChooseConfig(display, config_attributes, &config, 1, &count_configs) || count_configs == 0) {
+			std::cout << "ERROR::HEADLESS_CONTEXT::CREATE\nNo suitable EGL config.\n";
+			return false;
+		}
+
+		EGLint surface_attributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, surface_attributes);
+
+		eglBindAPI(EGL_OPENGL_API);
+		EGLint context_attributes[] = {
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+		if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+			std::cout << "ERROR::HEADLESS_CONTEXT::CREATE\nFailed to create EGL context.\n";
+			return false;
+		}
+
+		return true;
+	}
+
+	void destroy() {
+		if (display == EGL_NO_DISPLAY)
+			return;
+
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT)
+			eglDestroyContext(display, context);
+		if (surface != EGL_NO_SURFACE)
+			eglDestroySurface(display, surface);
+		eglTerminate(display);
+
+		display = EGL_NO_DISPLAY;
+		surface = EGL_NO_SURFACE;
+		context = EGL_NO_CONTEXT;
+	}
+
+	~HeadlessContext() {
+		destroy();
+	}
+};
@@ -0,0 +1,383 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../CommonClasses/Matrix.h"
+#include "../CommonClasses/Random.h"
+
+
+long long count_allocations = 0;
+
+void* operator new(size_t size) {
+	count_allocations++;
+	if (void* ptr = std::malloc(size == 0 ? 1 : size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	count_allocations++;
+	if (void* ptr = std::malloc(size == 0 ? 1 : size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+
+volatile double sink = 0;
+
+
+struct BenchResult {
+	std::string name;
+	long long count_operations = 0;
+	double ns_per_operation = 0, allocations_per_operation = 0;
+};
+
+
+BenchResult run_benchmark(std::string name, long long count_operations, std::function < double(long long) > operation) {
+	operation(std::max(count_operations / 10, 1LL));
+
+	long long allocations_begin = count_allocations;
+	std::chrono::steady_clock::time_point time_begin = std::chrono::steady_clock::now();
+	sink = sink + operation(count_operations);
+	std::chrono::steady_clock::time_point time_end = std::chrono::steady_clock::now();
+
+	BenchResult result;
+	result.name = name;
+	result.count_operations = count_operations;
+	result.ns_per_operation = std::chrono::duration < double, std::nano >(time_end - time_begin).count() / count_operations;
+	result.allocations_per_operation = ((double)(count_allocations - allocations_begin)) / count_operations;
+	return result;
+}
+
+
+Matrix random_matrix(Random& random) {
+	Matrix res(4, 4, 0);
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++)
+			res[i][j] = random.randfloat(-1, 1);
+	}
+	for (int i = 0; i < 4; i++)
+		res[i][i] += 4;
+	return res;
+}
+
+
+Matrix random_transform(Random& random) {
+	Matrix res = trans_matrix(random.randvect3(Vect3(-10, -10, -10), Vect3(10, 10, 10)));
+	res = res * rotate_matrix(random.randvect3(Vect3(-1, -1, -1), Vect3(1, 1, 1)), random.randfloat(0, 2 * PI));
+	return res * scale_matrix(random.randvect3(Vect3(0.1, 0.1, 0.1), Vect3(10, 10, 10)));
+}
+
+
+double max_difference(Matrix a, Matrix b) {
+	double res = 0;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++)
+			res = std::max(res, abs(a[i][j] - b[i][j]));
+	}
+	return res;
+}
+
+
+double max_abs(Matrix a) {
+	return max_difference(a, Matrix(4, 4, 0));
+}
+
+
+class PropertyChecker {
+	int count_checks = 0, count_failures = 0;
+
+public:
+	void check(std::string name, int seed, double error, double tolerance) {
+		count_checks++;
+		if (error <= tolerance && error == error)
+			return;
+
+		count_failures++;
+		if (count_failures <= 10)
+			std::cout << "ERROR::MATH_BENCHMARK::VERIFY\nProperty " << name << " failed for seed " << seed << ", error " << error << ".\n";
+	}
+
+	int get_count_checks() {
+		return count_checks;
+	}
+
+	int get_count_failures() {
+		return count_failures;
+	}
+};
+
+
+void verify(PropertyChecker& checker, int count_cases, int seed) {
+	for (int i = 0; i < count_cases; i++) {
+		int case_seed = seed + i;
+		Random random(case_seed);
+
+		Matrix a = random_matrix(random), b = random_matrix(random), c = random_matrix(random);
+		checker.check("inverse_round_trip", case_seed, max_difference(a * a.inverse(), one_matrix(4)), 1e-6);
+		checker.check("inverse_round_trip_left", case_seed, max_difference(a.inverse() * a, one_matrix(4)), 1e-6);
+
+		Matrix transform = random_transform(random);
+		checker.check("transform_inverse_round_trip", case_seed, max_difference(transform * transform.inverse(), one_matrix(4)), 1e-6);
+		checker.check("inverse_matches_gauss", case_seed, max_difference(a.inverse(), a.inverse_gauss()), 1e-6);
+		checker.check("affine_inverse_matches_gauss", case_seed, max_difference(transform.affine_inverse(), transform.inverse_gauss()), 1e-6 * std::max(max_abs(transform.inverse_gauss()), 1.0));
+
+		Matrix normal = transform.normal_matrix(), expected = transform.inverse_gauss();
+		double normal_error = 0;
+		for (int j = 0; j < 3; j++) {
+			for (int k = 0; k < 3; k++)
+				normal_error = std::max(normal_error, abs(normal[j][k] - expected[k][j]));
+		}
+		checker.check("normal_matrix", case_seed, normal_error, 1e-6);
+
+		double tolerance = 1e-9 * std::max(max_abs((a * b) * c), 1.0);
+		checker.check("associativity", case_seed, max_difference((a * b) * c, a * (b * c)), tolerance);
+
+		Vect3 axis = random.randvect3(Vect3(-1, -1, -1), Vect3(1, 1, 1));
+		double angle = random.randfloat(-2 * PI, 2 * PI);
+		Matrix rotation = rotate_matrix(axis, angle), rotation_t = rotate_matrix(axis, angle);
+		rotation_t.transp();
+		checker.check("rotation_orthonormality", case_seed, max_difference(rotation * rotation_t, one_matrix(4)), 1e-12);
+
+		double determinant = (Vect3(rotation[0][0], rotation[1][0], rotation[2][0]) ^ Vect3(rotation[0][1], rotation[1][1], rotation[2][1])) * Vect3(rotation[0][2], rotation[1][2], rotation[2][2]);
+		checker.check("rotation_determinant", case_seed, abs(determinant - 1), 1e-12);
+		checker.check("rotation_axis_fixed", case_seed, (rotation * axis.normalize() - axis.normalize()).length(), 1e-12);
+		checker.check("rotation_inverse", case_seed, max_difference(rotate_matrix(axis, -angle), rotation_t), 1e-12);
+
+		PointArray points(random.randint(1, 37)), transformed(points.size());
+		for (int j = 0; j < points.size(); j++)
+			points.set(j, random.randvect3(Vect3(-10, -10, -10), Vect3(10, 10, 10)).get_vec3());
+		transform_points(transform.get_mat4(), points.span(), transformed.span());
+
+		double transform_error = 0, distance_error = 0;
+		Vect3 centroid, min_point = Vect3(transformed.get(0)), max_point = min_point;
+		Vect3 view_pos = random.randvect3(Vect3(-10, -10, -10), Vect3(10, 10, 10));
+		std::vector < float > distances(points.size());
+		get_distances_sqr(transformed.span(), view_pos.get_vec3(), distances.data());
+		for (int j = 0; j < points.size(); j++) {
+			Vect3 expected_point = transform * Vect3(points.get(j));
+			transform_error = std::max(transform_error, (expected_point - Vect3(transformed.get(j))).length() / std::max(expected_point.length(), 1.0));
+			distance_error = std::max(distance_error, abs(distances[j] - (Vect3(transformed.get(j)) - view_pos).length_sqr()) / std::max((double)distances[j], 1.0));
+			centroid += Vect3(transformed.get(j)) / points.size();
+			min_point.set_min(Vect3(transformed.get(j)));
+			max_point.set_max(Vect3(transformed.get(j)));
+		}
+		checker.check("transform_points", case_seed, transform_error, 1e-5);
+		checker.check("distances_sqr", case_seed, distance_error, 1e-5);
+
+		vec3 box_min, box_max;
+		get_bounding_box(transformed.span(), box_min, box_max);
+		checker.check("centroid", case_seed, (Vect3(get_centroid(transformed.span())) - centroid).length() / std::max(centroid.length(), 1.0), 1e-5);
+		checker.check("bounding_box", case_seed, std::max((Vect3(box_min) - min_point).length(), (Vect3(box_max) - max_point).length()), 0);
+
+		Vect3 point = random.randvect3(Vect3(-10, -10, -10), Vect3(10, 10, 10));
+		Matrix other_transform = random_transform(random);
+		tolerance = 1e-9 * std::max(max_abs(transform * other_transform) * point.length(), 1.0);
+		checker.check("transform_composition", case_seed, ((transform * other_transform) * point - transform * (other_transform * point)).length(), tolerance);
+	}
+}
+
+
+int main(int argc, char** argv) {
+	long long scale = 1;
+	int seed = 42, count_cases = 1000;
+	std::string output = "";
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string key = argv[i];
+		if (key == "--scale")
+			scale = std::max(std::stoll(argv[i + 1]), 1LL);
+		else if (key == "--seed")
+			seed = std::stoi(argv[i + 1]);
+		else if (key == "--cases")
+			count_cases = std::stoi(argv[i + 1]);
+		else if (key == "--output")
+			output = argv[i + 1];
+	}
+
+	PropertyChecker checker;
+	verify(checker, count_cases, seed);
+
+	Random random(seed);
+	std::vector < Matrix > matrices, projective;
+	std::vector < Vect3 > points;
+	for (int i = 0; i < 64; i++) {
+		matrices.push_back(random_transform(random));
+		projective.push_back(random_matrix(random));
+		points.push_back(random.randvect3(Vect3(-10, -10, -10), Vect3(10, 10, 10)));
+	}
+
+	std::vector < Vect3 > batch(4096);
+	for (Vect3& point : batch)
+		point = random.randvect3(Vect3(-10, -10, -10), Vect3(10, 10, 10));
+
+	PointArray batch_soa(batch.size()), batch_result(batch.size());
+	for (int i = 0; i < (int)batch.size(); i++)
+		batch_soa.set(i, batch[i].get_vec3());
+	std::vector < float > batch_distances(batch.size());
+
+	std::vector < BenchResult > results;
+	results.push_back(run_benchmark("mat4_mul_mat4", 200000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += (matrices[i & 63] * matrices[(i + 1) & 63])[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("mat4_mul_vec", 1000000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += (matrices[i & 63] * points[(i + 7) & 63]).x;
+		return res;
+	}));
+	results.push_back(run_benchmark("mat4_inverse", 200000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += matrices[i & 63].inverse()[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("mat4_inverse_gauss", 2000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += matrices[i & 63].inverse_gauss()[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("mat4_inverse_projective", 200000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += projective[i & 63].inverse()[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("mat4_inverse_gauss_projective", 2000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += projective[i & 63].inverse_gauss()[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("mat4_affine_inverse", 200000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += matrices[i & 63].affine_inverse()[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("mat4_normal_matrix", 200000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += matrices[i & 63].normal_matrix()[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("rotate_matrix", 500000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += rotate_matrix(points[i & 63], 0.001 * i)[0][0];
+		return res;
+	}));
+	results.push_back(run_benchmark("batch_transform_points", 200 * scale * batch.size(), [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i += batch.size()) {
+			Matrix transform = matrices[(i / batch.size()) & 63];
+			for (Vect3& point : batch)
+				res += (transform * point).z;
+		}
+		return res;
+	}));
+	results.push_back(run_benchmark("batch_transform_points_soa", 2000 * scale * batch.size(), [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i += batch.size()) {
+			transform_points(matrices[(i / batch.size()) & 63].get_mat4(), batch_soa.span(), batch_result.span());
+			res += batch_result.z[i & 1023];
+		}
+		return res;
+	}));
+	results.push_back(run_benchmark("batch_centroid_soa", 5000 * scale * batch.size(), [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i += batch.size())
+			res += get_centroid(batch_soa.span()).x;
+		return res;
+	}));
+	results.push_back(run_benchmark("batch_bounding_box_soa", 5000 * scale * batch.size(), [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i += batch.size()) {
+			vec3 box_min, box_max;
+			get_bounding_box(batch_soa.span(), box_min, box_max);
+			res += box_max.x - box_min.x;
+		}
+		return res;
+	}));
+	results.push_back(run_benchmark("batch_distances_sqr_soa", 5000 * scale * batch.size(), [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i += batch.size()) {
+			get_distances_sqr(batch_soa.span(), points[(i / batch.size()) & 63].get_vec3(), batch_distances.data());
+			res += batch_distances[i & 1023];
+		}
+		return res;
+	}));
+	results.push_back(run_benchmark("vect3_normalize_cross", 2000000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += (points[i & 63] ^ points[(i + 1) & 63]).normalize().y;
+		return res;
+	}));
+	results.push_back(run_benchmark("random_randfloat", 10000000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += random.randfloat(-1, 1);
+		return res;
+	}));
+	results.push_back(run_benchmark("random_randvect3", 2000000 * scale, [&](long long count) {
+		double res = 0;
+		for (long long i = 0; i < count; i++)
+			res += random.randvect3(Vect3(-1, -1, -1), Vect3(1, 1, 1)).x;
+		return res;
+	}));
+
+	std::ostringstream result;
+	result << "{\n";
+	result << "  \"benchmark\": \"graphengine_math_bench\",\n";
+	result << "  \"seed\": " << seed << ",\n";
+#if defined(__AVX__)
+	result << "  \"simd\": \"avx\",\n";
+#elif defined(__SSE2__) || defined(_M_X64)
+	result << "  \"simd\": \"sse2\",\n";
+#else
+	result << "  \"simd\": \"scalar\",\n";
+#endif
+	result << "  \"verify\": { \"checks\": " << checker.get_count_checks() << ", \"failures\": " << checker.get_count_failures() << " },\n";
+	result << "  \"results\": [\n";
+	for (int i = 0; i < (int)results.size(); i++) {
+		result << "    { \"name\": \"" << results[i].name << "\", \"operations\": " << results[i].count_operations
+			<< ", \"ns_per_op\": " << results[i].ns_per_operation << ", \"allocs_per_op\": " << results[i].allocations_per_operation << " }"
+			<< (i + 1 < (int)results.size() ? ",\n" : "\n");
+	}
+	result << "  ]\n";
+	result << "}\n";
+
+	if (output.empty()) {
+		std::cout << result.str();
+	}
+	else {
+		std::ofstream output_file(output);
+		output_file << result.str();
+	}
+
+	return checker.get_count_failures() == 0 ? 0 : 1;
+}
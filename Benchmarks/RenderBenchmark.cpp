@@ -0,0 +1,279 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "HeadlessContext.h"
+#include "../GraphEngine.h"
+
+#ifndef GRAPHENGINE_SHADERS_PATH
+#define GRAPHENGINE_SHADERS_PATH "Shaders/"
+#endif
+
+
+struct BenchConfig {
+	int width = 1280, height = 720, frames = 300, warmup = 30, seed = 42;
+	int count_objects = 100, count_polygons = 12, count_instances = 16, count_lights = 2, occlusion = 0, indirect = 0, gpu_culling = 0;
+	double transparent_ratio = 0.1, border_ratio = 0.05;
+	std::string output = "";
+};
+
+
+struct SceneSize {
+	long long count_points = 0, count_triangles = 0, vertex_bytes = 0, index_bytes = 0, instance_bytes = 0;
+};
+
+
+bool parse_arguments(int argc, char** argv, BenchConfig& config) {
+	std::map < std::string, std::string > values;
+	for (int i = 1; i < argc; i++) {
+		std::string key = argv[i];
+		if (key == "--help" || key.substr(0, 2) != "--" || i + 1 >= argc) {
+			std::cout << "Usage: graphengine_bench [--objects N] [--polygons N] [--instances N] [--lights N]\n"
+				<< "                         [--transparent RATIO] [--border RATIO] [--frames N] [--warmup N]\n"
+				<< "                         [--width N] [--height N] [--seed N] [--occlusion 0|1]\n"
+				<< "                         [--indirect 0|1] [--gpu-culling 0|1] [--output PATH]\n";
+			return false;
+		}
+		values[key.substr(2)] = argv[++i];
+	}
+
+	for (std::pair < const std::string, std::string >& value : values) {
+		const std::string& key = value.first;
+		if (key == "objects")
+			config.count_objects = std::stoi(value.second);
+		else if (key == "polygons")
+			config.count_polygons = std::stoi(value.second);
+		else if (key == "instances")
+			config.count_instances = std::stoi(value.second);
+		else if (key == "lights")
+			config.count_lights = std::stoi(value.second);
+		else if (key == "transparent")
+			config.transparent_ratio = std::stod(value.second);
+		else if (key == "border")
+			config.border_ratio = std::stod(value.second);
+		else if (key == "frames")
+			config.frames = std::stoi(value.second);
+		else if (key == "warmup")
+			config.warmup = std::stoi(value.second);
+		else if (key == "width")
+			config.width = std::stoi(value.second);
+		else if (key == "height")
+			config.height = std::stoi(value.second);
+		else if (key == "seed")
+			config.seed = std::stoi(value.second);
+		else if (key == "occlusion")
+			config.occlusion = std::stoi(value.second);
+		else if (key == "indirect")
+			config.indirect = std::stoi(value.second);
+		else if (key == "gpu-culling")
+			config.gpu_culling = std::stoi(value.second);
+		else if (key == "output")
+			config.output = value.second;
+		else {
+			std::cout << "ERROR::BENCHMARK::ARGUMENTS\nUnknown option --" << key << ".\n";
+			return false;
+		}
+	}
+
+	config.count_objects = std::max(config.count_objects, 0);
+	config.count_polygons = std::max(config.count_polygons, 1);
+	config.count_instances = std::max(config.count_instances, 1);
+	config.frames = std::max(config.frames, 1);
+	return true;
+}
+
+
+GraphObject create_object(Shader* shader, Random& random, BenchConfig& config, SceneSize& scene_size) {
+	GraphObject object(config.count_instances, shader);
+	object.transparent = random.rand() < config.transparent_ratio;
+	object.border = random.rand() < config.border_ratio;
+
+	for (int i = 0; i < config.count_polygons; i++) {
+		int count_points = random.randint(3, 8);
+		std::vector < float > positions;
+		for (int j = 0; j < count_points; j++) {
+			double angle = 2 * PI * j / count_points;
+			positions.push_back(0.3 * cos(angle));
+			positions.push_back(0.3 * sin(angle));
+			positions.push_back(0);
+		}
+
+		Polygon polygon(count_points);
+		polygon.set_positions(positions);
+		polygon.change_matrix(rotate_matrix(random.randvect3(Vect3(-1, -1, -1), Vect3(1, 1, 1)), random.randfloat(0, 2 * PI)));
+		polygon.change_matrix(trans_matrix(random.randvect3(Vect3(-0.5, -0.5, -0.5), Vect3(0.5, 0.5, 0.5))));
+		polygon.material.ambient = random.randvect3(Vect3(0, 0, 0), Vect3(0.3, 0.3, 0.3));
+		polygon.material.diffuse = random.randvect3(Vect3(0.2, 0.2, 0.2), Vect3(1, 1, 1));
+		polygon.material.specular = Vect3(0.5, 0.5, 0.5);
+		polygon.material.shininess = 32;
+		polygon.material.alpha = object.transparent ? 0.5 : 1;
+		object.add_polygon(polygon);
+
+		scene_size.count_points += count_points;
+		scene_size.count_triangles += count_points - 2;
+		scene_size.vertex_bytes += sizeof(float) * 8 * count_points;
+		scene_size.index_bytes += sizeof(unsigned int) * 3 * (count_points - 2);
+	}
+
+	for (int i = 0; i < config.count_instances; i++) {
+		if (i > 0)
+			object.add_matrix();
+
+		double depth = random.randfloat(3, 60);
+		Vect3 position(random.randfloat(-0.8, 0.8) * depth, random.randfloat(-0.45, 0.45) * depth, depth);
+		object.change_matrix(rotate_matrix(random.randvect3(Vect3(-1, -1, -1), Vect3(1, 1, 1)), random.randfloat(0, 2 * PI)) * scale_matrix(random.randfloat(0.5, 2)), i);
+		object.change_matrix(trans_matrix(position), i);
+	}
+	scene_size.instance_bytes += sizeof(float) * INSTANCE_SIZE * config.count_instances;
+
+	return object;
+}
+
+
+void add_lights(GraphEngine& engine, Random& random, BenchConfig& config) {
+	int count_lights = std::min(config.count_lights, engine.get_count_lights());
+	for (int i = 0; i < count_lights; i++) {
+		Light* light;
+		if (i == 0) {
+			light = new DirLight(Vect3(-1, -1, 1));
+		}
+		else {
+			PointLight* point_light = new PointLight(random.randvect3(Vect3(-10, -5, 5), Vect3(10, 5, 40)));
+			point_light->linear = 0.05;
+			point_light->quadratic = 0.01;
+			light = point_light;
+		}
+
+		light->ambient = Vect3(0.1, 0.1, 0.1);
+		light->diffuse = Vect3(0.7, 0.7, 0.7);
+		light->specular = Vect3(0.5, 0.5, 0.5);
+		engine.set_light(i, light);
+	}
+}
+
+
+long long read_memory_kb(std::string field) {
+	std::ifstream status("/proc/self/status");
+	for (std::string line; std::getline(status, line); ) {
+		if (line.substr(0, field.size() + 1) == field + ":")
+			return std::stoll(line.substr(field.size() + 1));
+	}
+	return -1;
+}
+
+
+std::string format_stat(std::vector < double > values) {
+	if (values.empty())
+		return "{}";
+
+	std::sort(values.begin(), values.end());
+	double sum = 0;
+	for (double value : values)
+		sum += value;
+
+	int count = values.size();
+	std::ostringstream result;
+	result << "{ \"min\": " << values[0] << ", \"avg\": " << sum / count << ", \"p50\": " << values[count / 2]
+		<< ", \"p99\": " << values[std::min((int)ceil(0.99 * count) - 1, count - 1)] << ", \"max\": " << values[count - 1] << " }";
+	return result.str();
+}
+
+
+std::string format_stat(StatValue value) {
+	std::ostringstream result;
+	result << "{ \"min\": " << value.min << ", \"avg\": " << value.avg << ", \"p99\": " << value.p99 << " }";
+	return result.str();
+}
+
+
+int main(int argc, char** argv) {
+	BenchConfig config;
+	if (!parse_arguments(argc, argv, config))
+		return 2;
+
+	HeadlessContext context;
+	if (!context.create(config.width, config.height))
+		return 1;
+
+	std::chrono::steady_clock::time_point setup_begin = std::chrono::steady_clock::now();
+
+	GraphEngine* engine = new GraphEngine(config.width, config.height, PI / 2, 0.1, 100, GRAPHENGINE_SHADERS_PATH);
+	engine->set_occlusion_culling(config.occlusion != 0);
+	engine->set_indirect_draw(config.indirect != 0);
+	engine->set_gpu_culling(config.gpu_culling != 0);
+
+	Random random(config.seed);
+	SceneSize scene_size;
+	add_lights(*engine, random, config);
+	for (int i = 0; i < config.count_objects; i++)
+		engine->add_object(create_object(engine->get_main_shader(), random, config, scene_size));
+	glFinish();
+
+	double setup_time = std::chrono::duration < double, std::milli >(std::chrono::steady_clock::now() - setup_begin).count();
+
+	for (int i = 0; i < config.warmup; i++)
+		engine->draw();
+	glFinish();
+	engine->set_stats_window(config.frames);
+
+	std::vector < double > frame_times, submit_times;
+	for (int i = 0; i < config.frames; i++) {
+		std::chrono::steady_clock::time_point frame_begin = std::chrono::steady_clock::now();
+		engine->draw();
+		std::chrono::steady_clock::time_point frame_submit = std::chrono::steady_clock::now();
+		glFinish();
+		std::chrono::steady_clock::time_point frame_end = std::chrono::steady_clock::now();
+
+		submit_times.push_back(std::chrono::duration < double, std::milli >(frame_submit - frame_begin).count());
+		frame_times.push_back(std::chrono::duration < double, std::milli >(frame_end - frame_begin).count());
+	}
+	engine->draw();
+
+	RenderStats stats = engine->get_stats();
+	GLenum error = glGetError();
+
+	std::ostringstream result;
+	result << "{\n";
+	result << "  \"benchmark\": \"graphengine_bench\",\n";
+	result << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\",\n";
+	result << "  \"gl_version\": \"" << (const char*)glGetString(GL_VERSION) << "\",\n";
+	result << "  \"config\": { \"width\": " << config.width << ", \"height\": " << config.height << ", \"frames\": " << config.frames
+		<< ", \"warmup\": " << config.warmup << ", \"seed\": " << config.seed << ", \"objects\": " << config.count_objects
+		<< ", \"polygons\": " << config.count_polygons << ", \"instances\": " << config.count_instances
+		<< ", \"lights\": " << std::min(config.count_lights, engine->get_count_lights())
+		<< ", \"transparent_ratio\": " << config.transparent_ratio << ", \"border_ratio\": " << config.border_ratio
+		<< ", \"occlusion\": " << config.occlusion << ", \"indirect\": " << config.indirect << ", \"gpu_culling\": " << config.gpu_culling << " },\n";
+	result << "  \"setup_ms\": " << setup_time << ",\n";
+	result << "  \"frame_ms\": " << format_stat(frame_times) << ",\n";
+	result << "  \"submit_ms\": " << format_stat(submit_times) << ",\n";
+	result << "  \"gpu_ms\": { \"frame\": " << format_stat(stats.gpu_frame) << ", \"lights\": " << format_stat(stats.gpu_lights)
+		<< ", \"opaque\": " << format_stat(stats.gpu_opaque) << ", \"transparent\": " << format_stat(stats.gpu_transparent)
+		<< ", \"post\": " << format_stat(stats.gpu_post) << " },\n";
+	result << "  \"per_frame\": { \"draw_calls\": " << format_stat(stats.draw_calls) << ", \"instances\": " << format_stat(stats.instances)
+		<< ", \"triangles\": " << format_stat(stats.triangles) << ", \"uniform_uploads\": " << format_stat(stats.uniform_uploads)
+		<< ", \"buffer_uploads\": " << format_stat(stats.buffer_uploads) << ", \"texture_binds\": " << format_stat(stats.texture_binds)
+		<< ", \"elided_state_calls\": " << format_stat(stats.elided_state_calls) << ", \"culled_instances\": " << format_stat(stats.culled_instances) << " },\n";
+	result << "  \"memory\": { \"rss_kb\": " << read_memory_kb("VmRSS") << ", \"peak_rss_kb\": " << read_memory_kb("VmHWM")
+		<< ", \"vertex_bytes\": " << scene_size.vertex_bytes << ", \"index_bytes\": " << scene_size.index_bytes
+		<< ", \"instance_bytes\": " << scene_size.instance_bytes << ", \"points\": " << scene_size.count_points
+		<< ", \"triangles\": " << scene_size.count_triangles << " },\n";
+	result << "  \"gl_error\": " << error << "\n";
+	result << "}\n";
+
+	if (config.output.empty()) {
+		std::cout << result.str();
+	}
+	else {
+		std::ofstream output(config.output);
+		output << result.str();
+	}
+
+	delete engine;
+	context.destroy();
+	return 0;
+}
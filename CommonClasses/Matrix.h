@@ -73,6 +73,16 @@ public:
 		};
 	}
 
+	Matrix(const mat4& matrix) {
+		s = 4;
+		c = 4;
+		mx.resize(4, std::vector < double >(4));
+		for (int j = 0; j < 4; j++) {
+			for (int i = 0; i < 4; i++)
+				mx[i][j] = matrix.m[4 * j + i];
+		}
+	}
+
 	Matrix(int s, int c, int vl) {
 		this->s = s;
 		this->c = c;
@@ -124,12 +134,7 @@ public:
 		return *this;
 	}
 
-	Matrix inverse() {
-		if (s != c) {
-			std::cout << "ERROR::MATRIX::MULTIPLICATION\n" << "Incorrect matrix sizes.\n";
-			return Matrix();
-		}
-
+	Matrix inverse_gauss() {
 		std::vector < double > ans(s * c, 0);
 		std::vector < std::vector < double > > mx_k(s * c, std::vector < double >(s * c, 0));
 		for (int i = 0; i < s; i++) {
@@ -150,6 +155,114 @@ public:
 		return Matrix(res);
 	}
 
+	Matrix inverse() {
+		if (s != c) {
+			std::cout << "ERROR::MATRIX::INVERSE\n" << "Incorrect matrix sizes.\n";
+			return Matrix();
+		}
+
+		if (s != 4)
+			return inverse_gauss();
+
+		if (is_affine())
+			return affine_inverse();
+
+		double s0 = mx[0][0] * mx[1][1] - mx[1][0] * mx[0][1];
+		double s1 = mx[0][0] * mx[1][2] - mx[1][0] * mx[0][2];
+		double s2 = mx[0][0] * mx[1][3] - mx[1][0] * mx[0][3];
+		double s3 = mx[0][1] * mx[1][2] - mx[1][1] * mx[0][2];
+		double s4 = mx[0][1] * mx[1][3] - mx[1][1] * mx[0][3];
+		double s5 = mx[0][2] * mx[1][3] - mx[1][2] * mx[0][3];
+
+		double c5 = mx[2][2] * mx[3][3] - mx[3][2] * mx[2][3];
+		double c4 = mx[2][1] * mx[3][3] - mx[3][1] * mx[2][3];
+		double c3 = mx[2][1] * mx[3][2] - mx[3][1] * mx[2][2];
+		double c2 = mx[2][0] * mx[3][3] - mx[3][0] * mx[2][3];
+		double c1 = mx[2][0] * mx[3][2] - mx[3][0] * mx[2][2];
+		double c0 = mx[2][0] * mx[3][1] - mx[3][0] * mx[2][1];
+
+		double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+		if (is_singular(det, 4))
+			return inverse_gauss();
+
+		double k = 1 / det;
+		return Matrix({
+			{ ( mx[1][1] * c5 - mx[1][2] * c4 + mx[1][3] * c3) * k, (-mx[0][1] * c5 + mx[0][2] * c4 - mx[0][3] * c3) * k, ( mx[3][1] * s5 - mx[3][2] * s4 + mx[3][3] * s3) * k, (-mx[2][1] * s5 + mx[2][2] * s4 - mx[2][3] * s3) * k },
+			{ (-mx[1][0] * c5 + mx[1][2] * c2 - mx[1][3] * c1) * k, ( mx[0][0] * c5 - mx[0][2] * c2 + mx[0][3] * c1) * k, (-mx[3][0] * s5 + mx[3][2] * s2 - mx[3][3] * s1) * k, ( mx[2][0] * s5 - mx[2][2] * s2 + mx[2][3] * s1) * k },
+			{ ( mx[1][0] * c4 - mx[1][1] * c2 + mx[1][3] * c0) * k, (-mx[0][0] * c4 + mx[0][1] * c2 - mx[0][3] * c0) * k, ( mx[3][0] * s4 - mx[3][1] * s2 + mx[3][3] * s0) * k, (-mx[2][0] * s4 + mx[2][1] * s2 - mx[2][3] * s0) * k },
+			{ (-mx[1][0] * c3 + mx[1][1] * c1 - mx[1][2] * c0) * k, ( mx[0][0] * c3 - mx[0][1] * c1 + mx[0][2] * c0) * k, (-mx[3][0] * s3 + mx[3][1] * s1 - mx[3][2] * s0) * k, ( mx[2][0] * s3 - mx[2][1] * s1 + mx[2][2] * s0) * k },
+		});
+	}
+
+	double get_row_norms(int size) {
+		double result = 1;
+		for (int i = 0; i < size; i++) {
+			double norm = 0;
+			for (int j = 0; j < size; j++)
+				norm += mx[i][j] * mx[i][j];
+			result *= sqrt(norm);
+		}
+		return result;
+	}
+
+	bool is_singular(double det, int size) {
+		return abs(det) <= 0.000001 * get_row_norms(size);
+	}
+
+	double det3() {
+		return mx[0][0] * (mx[1][1] * mx[2][2] - mx[1][2] * mx[2][1]) - mx[0][1] * (mx[1][0] * mx[2][2] - mx[1][2] * mx[2][0]) + mx[0][2] * (mx[1][0] * mx[2][1] - mx[1][1] * mx[2][0]);
+	}
+
+	bool is_affine() {
+		return s == 4 && c == 4 && mx[3][0] == 0 && mx[3][1] == 0 && mx[3][2] == 0 && mx[3][3] == 1;
+	}
+
+	Matrix affine_inverse() {
+		if (!is_affine()) {
+			std::cout << "ERROR::MATRIX::AFFINE_INVERSE\n" << "Matrix is not affine.\n";
+			return inverse();
+		}
+
+		if (is_singular(det3(), 3))
+			return inverse_gauss();
+
+		Matrix res = normal_matrix();
+		res.transp();
+		std::vector < std::vector < double > > inv = {
+			{ res[0][0], res[0][1], res[0][2], 0 },
+			{ res[1][0], res[1][1], res[1][2], 0 },
+			{ res[2][0], res[2][1], res[2][2], 0 },
+			{         0,         0,         0, 1 },
+		};
+		for (int i = 0; i < 3; i++)
+			inv[i][3] = -(inv[i][0] * mx[0][3] + inv[i][1] * mx[1][3] + inv[i][2] * mx[2][3]);
+
+		return Matrix(inv);
+	}
+
+	Matrix normal_matrix() {
+		if (s < 3 || c < 3) {
+			std::cout << "ERROR::MATRIX::NORMAL_MATRIX\n" << "Incorrect matrix sizes.\n";
+			return Matrix();
+		}
+
+		std::vector < std::vector < double > > cof = {
+			{ mx[1][1] * mx[2][2] - mx[1][2] * mx[2][1], mx[1][2] * mx[2][0] - mx[1][0] * mx[2][2], mx[1][0] * mx[2][1] - mx[1][1] * mx[2][0] },
+			{ mx[0][2] * mx[2][1] - mx[0][1] * mx[2][2], mx[0][0] * mx[2][2] - mx[0][2] * mx[2][0], mx[0][1] * mx[2][0] - mx[0][0] * mx[2][1] },
+			{ mx[0][1] * mx[1][2] - mx[0][2] * mx[1][1], mx[0][2] * mx[1][0] - mx[0][0] * mx[1][2], mx[0][0] * mx[1][1] - mx[0][1] * mx[1][0] },
+		};
+
+		double det = det3();
+		if (is_singular(det, 3))
+			return Matrix(cof);
+
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++)
+				cof[i][j] /= det;
+		}
+		return Matrix(cof);
+	}
+
 	int size_s() {
 		return s;
 	}
@@ -158,6 +271,15 @@ public:
 		return c;
 	}
 
+	mat4 get_mat4() {
+		mat4 res;
+		for (int j = 0; j < 4; j++) {
+			for (int i = 0; i < 4; i++)
+				res.m[4 * j + i] = i < s && j < c ? mx[i][j] : (i == j);
+		}
+		return res;
+	}
+
 	float* value_ptr() {
 		float* res = new float[s * c];
 		for (int j = 0; j < c; j++) {
@@ -3,13 +3,15 @@
 #include <math.h>
 #include <algorithm>
 #include <iostream>
+#include <vector>
+#include "VectorMath.h"
 
 
 const double PI = acos(-1);
 
 
 class Vect3 {
-	double inf = 1e18, eps = 0.00001;
+	static constexpr double inf = 1e18, eps = 0.00001;
 
 public:
 	double x, y, z, w;
@@ -21,27 +23,28 @@ public:
 		this->w = w;
 	}
 
+	Vect3(vec3 init) {
+		x = init.x;
+		y = init.y;
+		z = init.z;
+		w = 1;
+	}
+
 	Vect3(std::vector < double > init) {
 		for (int i = 0; i < std::min(4, (int)init.size()); i++)
 			(*this)[i] = init[i];
 	}
 
 	double& operator[](int index) {
-		if (index == 0)
-			return x;
-		if (index == 1)
-			return y;
-		if (index == 2)
-			return z;
-		if (index == 3)
-			return w;
+		static constexpr double Vect3::* coords[] = { &Vect3::x, &Vect3::y, &Vect3::z, &Vect3::w };
+		return this->*coords[index];
 	}
 
-	bool operator ==(Vect3 other) {
+	bool operator ==(Vect3 other) const {
 		return x == other.x && y == other.y && z == other.z;
 	}
 
-	bool operator !=(Vect3 other) {
+	bool operator !=(Vect3 other) const {
 		return x != other.x || y != other.y || z != other.z;
 	}
 
@@ -106,6 +109,7 @@ public:
 		if (other != 0)
 			return Vect3(x / other, y / other, z / other);
 		std::cout << "ERROR::VECT3::DIVISION\n" << "Division by zero.\n";
+		return *this;
 	}
 
 	double length_sqr() {
@@ -154,6 +158,10 @@ public:
 		return new float[3]{ (float)x, (float)y, (float)z };
 	}
 
+	vec3 get_vec3() {
+		return { (float)x, (float)y, (float)z };
+	}
+
 	std::vector < double > value_vector() {
 		return { x, y, z };
 	}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+
+struct vec3 {
+	float x, y, z;
+};
+
+
+struct vec4 {
+	float x, y, z, w;
+};
+
+
+struct mat4 {
+	float m[16];
+
+	vec3 transform_point(vec3 point) const {
+		return {
+			m[0] * point.x + m[4] * point.y + m[8] * point.z + m[12],
+			m[1] * point.x + m[5] * point.y + m[9] * point.z + m[13],
+			m[2] * point.x + m[6] * point.y + m[10] * point.z + m[14]
+		};
+	}
+
+	void get_normal_matrix(float* res) const {
+		double cof[9] = {
+			(double)m[5] * m[10] - (double)m[9] * m[6], (double)m[9] * m[2] - (double)m[1] * m[10], (double)m[1] * m[6] - (double)m[5] * m[2],
+			(double)m[8] * m[6] - (double)m[4] * m[10], (double)m[0] * m[10] - (double)m[8] * m[2], (double)m[4] * m[2] - (double)m[0] * m[6],
+			(double)m[4] * m[9] - (double)m[8] * m[5], (double)m[8] * m[1] - (double)m[0] * m[9], (double)m[0] * m[5] - (double)m[4] * m[1]
+		};
+		double det = m[0] * cof[0] + m[4] * cof[1] + m[8] * cof[2];
+		for (int j = 0; j < 3; j++) {
+			for (int i = 0; i < 3; i++)
+				res[3 * j + i] = fabs(det) < 0.000001 ? cof[3 * i + j] : cof[3 * i + j] / det;
+		}
+	}
+
+	mat4 operator *(const mat4& other) const {
+		mat4 res;
+		for (int j = 0; j < 4; j++) {
+			for (int i = 0; i < 4; i++)
+				res.m[4 * j + i] = m[i] * other.m[4 * j] + m[4 + i] * other.m[4 * j + 1] + m[8 + i] * other.m[4 * j + 2] + m[12 + i] * other.m[4 * j + 3];
+		}
+		return res;
+	}
+};
+
+
+struct PointSpan {
+	float* x;
+	float* y;
+	float* z;
+	int count;
+};
+
+
+class PointArray {
+public:
+	std::vector < float > x, y, z;
+
+	PointArray(int count = 0) {
+		resize(count);
+	}
+
+	PointArray(const std::vector < float >& positions) {
+		int count = positions.size() / 3;
+		resize(count);
+		for (int i = 0; i < count; i++) {
+			x[i] = positions[3 * i];
+			y[i] = positions[3 * i + 1];
+			z[i] = positions[3 * i + 2];
+		}
+	}
+
+	void resize(int count) {
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+	}
+
+	int size() const {
+		return x.size();
+	}
+
+	void set(int id, vec3 point) {
+		x[id] = point.x;
+		y[id] = point.y;
+		z[id] = point.z;
+	}
+
+	vec3 get(int id) const {
+		return { x[id], y[id], z[id] };
+	}
+
+	PointSpan span() {
+		return { x.data(), y.data(), z.data(), size() };
+	}
+
+	std::vector < float > interleave() const {
+		std::vector < float > positions(3 * size());
+		for (int i = 0; i < size(); i++) {
+			positions[3 * i] = x[i];
+			positions[3 * i + 1] = y[i];
+			positions[3 * i + 2] = z[i];
+		}
+		return positions;
+	}
+};
+
+
+void transform_points(const mat4& matrix, PointSpan src, PointSpan dst) {
+	const float* m = matrix.m;
+	int count = std::min(src.count, dst.count), i = 0;
+
+#if defined(__AVX__)
+	for (; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_loadu_ps(src.x + i), y = _mm256_loadu_ps(src.y + i), z = _mm256_loadu_ps(src.z + i);
+		for (int k = 0; k < 3; k++) {
+			__m256 res = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[k]), x), _mm256_set1_ps(m[12 + k]));
+			res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_set1_ps(m[4 + k]), y));
+			res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_set1_ps(m[8 + k]), z));
+			_mm256_storeu_ps((k == 0 ? dst.x : k == 1 ? dst.y : dst.z) + i, res);
+		}
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(src.x + i), y = _mm_loadu_ps(src.y + i), z = _mm_loadu_ps(src.z + i);
+		for (int k = 0; k < 3; k++) {
+			__m128 res = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[k]), x), _mm_set1_ps(m[12 + k]));
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_set1_ps(m[4 + k]), y));
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_set1_ps(m[8 + k]), z));
+			_mm_storeu_ps((k == 0 ? dst.x : k == 1 ? dst.y : dst.z) + i, res);
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		float x = src.x[i], y = src.y[i], z = src.z[i];
+		dst.x[i] = m[0] * x + m[4] * y + m[8] * z + m[12];
+		dst.y[i] = m[1] * x + m[5] * y + m[9] * z + m[13];
+		dst.z[i] = m[2] * x + m[6] * y + m[10] * z + m[14];
+	}
+}
+
+
+float sum_floats(const float* values, int count) {
+	int i = 0;
+	float res = 0;
+
+#if defined(__AVX__)
+	__m256 sum = _mm256_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(values + i));
+
+	float lanes[8];
+	_mm256_storeu_ps(lanes, sum);
+	for (float lane : lanes)
+		res += lane;
+#elif defined(__SSE2__) || defined(_M_X64)
+	__m128 sum = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+		sum = _mm_add_ps(sum, _mm_loadu_ps(values + i));
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	for (float lane : lanes)
+		res += lane;
+#endif
+
+	for (; i < count; i++)
+		res += values[i];
+	return res;
+}
+
+
+vec3 get_centroid(PointSpan points) {
+	if (points.count == 0)
+		return { 0, 0, 0 };
+
+	return {
+		sum_floats(points.x, points.count) / points.count,
+		sum_floats(points.y, points.count) / points.count,
+		sum_floats(points.z, points.count) / points.count
+	};
+}
+
+
+void get_min_max(const float* values, int count, float& min_value, float& max_value) {
+	int i = 0;
+	min_value = INFINITY;
+	max_value = -INFINITY;
+
+#if defined(__AVX__)
+	__m256 min_lanes = _mm256_set1_ps(INFINITY), max_lanes = _mm256_set1_ps(-INFINITY);
+	for (; i + 8 <= count; i += 8) {
+		__m256 value = _mm256_loadu_ps(values + i);
+		min_lanes = _mm256_min_ps(min_lanes, value);
+		max_lanes = _mm256_max_ps(max_lanes, value);
+	}
+
+	float lanes[16];
+	_mm256_storeu_ps(lanes, min_lanes);
+	_mm256_storeu_ps(lanes + 8, max_lanes);
+	for (int j = 0; j < 8; j++) {
+		min_value = std::min(min_value, lanes[j]);
+		max_value = std::max(max_value, lanes[8 + j]);
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	__m128 min_lanes = _mm_set1_ps(INFINITY), max_lanes = _mm_set1_ps(-INFINITY);
+	for (; i + 4 <= count; i += 4) {
+		__m128 value = _mm_loadu_ps(values + i);
+		min_lanes = _mm_min_ps(min_lanes, value);
+		max_lanes = _mm_max_ps(max_lanes, value);
+	}
+
+	float lanes[8];
+	_mm_storeu_ps(lanes, min_lanes);
+	_mm_storeu_ps(lanes + 4, max_lanes);
+	for (int j = 0; j < 4; j++) {
+		min_value = std::min(min_value, lanes[j]);
+		max_value = std::max(max_value, lanes[4 + j]);
+	}
+#endif
+
+	for (; i < count; i++) {
+		min_value = std::min(min_value, values[i]);
+		max_value = std::max(max_value, values[i]);
+	}
+}
+
+
+void get_bounding_box(PointSpan points, vec3& min_point, vec3& max_point) {
+	get_min_max(points.x, points.count, min_point.x, max_point.x);
+	get_min_max(points.y, points.count, min_point.y, max_point.y);
+	get_min_max(points.z, points.count, min_point.z, max_point.z);
+}
+
+
+void get_distances_sqr(PointSpan points, vec3 point, float* distances) {
+	int i = 0;
+
+#if defined(__AVX__)
+	__m256 px = _mm256_set1_ps(point.x), py = _mm256_set1_ps(point.y), pz = _mm256_set1_ps(point.z);
+	for (; i + 8 <= points.count; i += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(points.x + i), px);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(points.y + i), py);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(points.z + i), pz);
+		__m256 res = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		_mm256_storeu_ps(distances + i, res);
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	__m128 px = _mm_set1_ps(point.x), py = _mm_set1_ps(point.y), pz = _mm_set1_ps(point.z);
+	for (; i + 4 <= points.count; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(points.x + i), px);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(points.y + i), py);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(points.z + i), pz);
+		__m128 res = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		_mm_storeu_ps(distances + i, res);
+	}
+#endif
+
+	for (; i < points.count; i++) {
+		float dx = points.x[i] - point.x, dy = points.y[i] - point.y, dz = points.z[i] - point.z;
+		distances[i] = dx * dx + dy * dy + dz * dz;
+	}
+}
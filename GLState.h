@@ -0,0 +1,312 @@
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <GL/glew.h>
+#include "RenderStats.h"
+
+
+class GLState {
+	static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+	unsigned int program = UNKNOWN, vertex_array = UNKNOWN, framebuffer = UNKNOWN, active_unit = UNKNOWN;
+	unsigned int stencil_func = UNKNOWN, stencil_ref = UNKNOWN, stencil_value_mask = UNKNOWN, stencil_write_mask = UNKNOWN;
+	unsigned int stencil_fail = UNKNOWN, stencil_depth_fail = UNKNOWN, stencil_depth_pass = UNKNOWN;
+	unsigned int blend_src = UNKNOWN, blend_dst = UNKNOWN, blend_src_alpha = UNKNOWN, blend_dst_alpha = UNKNOWN, depth_write_mask = UNKNOWN;
+	std::map < GLenum, unsigned int > buffers, capabilities;
+	std::map < std::pair < unsigned int, GLenum >, unsigned int > textures;
+
+	bool skip(bool same) {
+		if (same) {
+			count_elided_calls++;
+			frame_counters.elided_state_calls++;
+		}
+		return same;
+	}
+
+	GLenum get_buffer_binding(GLenum target) {
+		switch (target) {
+		case GL_ARRAY_BUFFER: return GL_ARRAY_BUFFER_BINDING;
+		case GL_ELEMENT_ARRAY_BUFFER: return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+		case GL_COPY_READ_BUFFER: return GL_COPY_READ_BUFFER_BINDING;
+		case GL_COPY_WRITE_BUFFER: return GL_COPY_WRITE_BUFFER_BINDING;
+		case GL_PIXEL_PACK_BUFFER: return GL_PIXEL_PACK_BUFFER_BINDING;
+		case GL_PIXEL_UNPACK_BUFFER: return GL_PIXEL_UNPACK_BUFFER_BINDING;
+		case GL_UNIFORM_BUFFER: return GL_UNIFORM_BUFFER_BINDING;
+		case GL_DRAW_INDIRECT_BUFFER: return GL_DRAW_INDIRECT_BUFFER_BINDING;
+		case GL_SHADER_STORAGE_BUFFER: return GL_SHADER_STORAGE_BUFFER_BINDING;
+		case GL_DISPATCH_INDIRECT_BUFFER: return GL_DISPATCH_INDIRECT_BUFFER_BINDING;
+		default: return 0;
+		}
+	}
+
+	GLenum get_texture_binding(GLenum target) {
+		switch (target) {
+		case GL_TEXTURE_2D: return GL_TEXTURE_BINDING_2D;
+		case GL_TEXTURE_2D_ARRAY: return GL_TEXTURE_BINDING_2D_ARRAY;
+		case GL_TEXTURE_BUFFER: return GL_TEXTURE_BINDING_BUFFER;
+		default: return 0;
+		}
+	}
+
+	void check_value(std::string name, unsigned int cached, GLenum query, bool& valid) {
+		if (cached == UNKNOWN || query == 0)
+			return;
+
+		int actual = 0;
+		glGetIntegerv(query, &actual);
+		if ((unsigned int)actual == cached)
+			return;
+
+		std::cout << "ERROR::GL_STATE::VALIDATE\n" << name << " cached " << cached << " but bound " << actual << ".\n";
+		valid = false;
+	}
+
+	void after_call() {
+		if (debug)
+			validate();
+	}
+
+public:
+	bool debug = false;
+	long long count_elided_calls = 0, count_issued_calls = 0;
+
+	void invalidate() {
+		program = vertex_array = framebuffer = active_unit = UNKNOWN;
+		stencil_func = stencil_ref = stencil_value_mask = stencil_write_mask = UNKNOWN;
+		stencil_fail = stencil_depth_fail = stencil_depth_pass = UNKNOWN;
+		blend_src = blend_dst = blend_src_alpha = blend_dst_alpha = depth_write_mask = UNKNOWN;
+		buffers.clear();
+		capabilities.clear();
+		textures.clear();
+	}
+
+	void use_program(unsigned int program) {
+		if (!skip(this->program == program)) {
+			glUseProgram(program);
+			this->program = program;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void bind_vertex_array(unsigned int vertex_array) {
+		if (!skip(this->vertex_array == vertex_array)) {
+			glBindVertexArray(vertex_array);
+			this->vertex_array = vertex_array;
+			buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void bind_buffer(GLenum target, unsigned int buffer) {
+		std::map < GLenum, unsigned int >::iterator it = buffers.find(target);
+		if (!skip(it != buffers.end() && it->second == buffer)) {
+			glBindBuffer(target, buffer);
+			buffers[target] = buffer;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer) {
+		glBindBufferBase(target, index, buffer);
+		buffers[target] = buffer;
+		count_issued_calls++;
+		after_call();
+	}
+
+	void bind_framebuffer(unsigned int framebuffer) {
+		if (!skip(this->framebuffer == framebuffer)) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			this->framebuffer = framebuffer;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void active_texture(unsigned int unit) {
+		if (!skip(active_unit == unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			active_unit = unit;
+			count_issued_calls++;
+		}
+	}
+
+	void bind_texture(GLenum target, unsigned int texture) {
+		if (active_unit == UNKNOWN)
+			active_texture(0);
+
+		std::map < std::pair < unsigned int, GLenum >, unsigned int >::iterator it = textures.find({ active_unit, target });
+		if (!skip(it != textures.end() && it->second == texture)) {
+			glBindTexture(target, texture);
+			textures[{ active_unit, target }] = texture;
+			count_issued_calls++;
+			frame_counters.texture_binds++;
+		}
+		after_call();
+	}
+
+	void bind_texture_unit(unsigned int unit, GLenum target, unsigned int texture) {
+		std::map < std::pair < unsigned int, GLenum >, unsigned int >::iterator it = textures.find({ unit, target });
+		if (skip(it != textures.end() && it->second == texture)) {
+			after_call();
+			return;
+		}
+
+		active_texture(unit);
+		bind_texture(target, texture);
+	}
+
+	void set_capability(GLenum capability, bool enabled) {
+		std::map < GLenum, unsigned int >::iterator it = capabilities.find(capability);
+		if (!skip(it != capabilities.end() && it->second == (unsigned int)enabled)) {
+			if (enabled)
+				glEnable(capability);
+			else
+				glDisable(capability);
+			capabilities[capability] = enabled;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void set_stencil_func(GLenum func, int ref, unsigned int mask) {
+		if (!skip(stencil_func == func && stencil_ref == (unsigned int)ref && stencil_value_mask == mask)) {
+			glStencilFunc(func, ref, mask);
+			stencil_func = func;
+			stencil_ref = ref;
+			stencil_value_mask = mask;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void set_stencil_mask(unsigned int mask) {
+		if (!skip(stencil_write_mask == mask)) {
+			glStencilMask(mask);
+			stencil_write_mask = mask;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void set_stencil_op(GLenum fail, GLenum depth_fail, GLenum depth_pass) {
+		if (!skip(stencil_fail == fail && stencil_depth_fail == depth_fail && stencil_depth_pass == depth_pass)) {
+			glStencilOp(fail, depth_fail, depth_pass);
+			stencil_fail = fail;
+			stencil_depth_fail = depth_fail;
+			stencil_depth_pass = depth_pass;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void set_blend_func(GLenum src, GLenum dst) {
+		set_blend_func_separate(src, dst, src, dst);
+	}
+
+	void set_blend_func_separate(GLenum src, GLenum dst, GLenum src_alpha, GLenum dst_alpha) {
+		if (!skip(blend_src == src && blend_dst == dst && blend_src_alpha == src_alpha && blend_dst_alpha == dst_alpha)) {
+			glBlendFuncSeparate(src, dst, src_alpha, dst_alpha);
+			blend_src = src;
+			blend_dst = dst;
+			blend_src_alpha = src_alpha;
+			blend_dst_alpha = dst_alpha;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void set_depth_mask(bool enabled) {
+		if (!skip(depth_write_mask == (unsigned int)enabled)) {
+			glDepthMask(enabled);
+			depth_write_mask = enabled;
+			count_issued_calls++;
+		}
+		after_call();
+	}
+
+	void delete_program(unsigned int program) {
+		glDeleteProgram(program);
+		if (this->program == program)
+			this->program = UNKNOWN;
+	}
+
+	void delete_vertex_array(unsigned int vertex_array) {
+		glDeleteVertexArrays(1, &vertex_array);
+		if (this->vertex_array == vertex_array) {
+			this->vertex_array = 0;
+			buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+		}
+	}
+
+	void delete_buffer(unsigned int buffer) {
+		glDeleteBuffers(1, &buffer);
+		for (std::pair < const GLenum, unsigned int >& binding : buffers) {
+			if (binding.second == buffer)
+				binding.second = 0;
+		}
+	}
+
+	void delete_framebuffer(unsigned int framebuffer) {
+		glDeleteFramebuffers(1, &framebuffer);
+		if (this->framebuffer == framebuffer)
+			this->framebuffer = 0;
+	}
+
+	void delete_texture(unsigned int texture) {
+		glDeleteTextures(1, &texture);
+		for (std::pair < const std::pair < unsigned int, GLenum >, unsigned int >& binding : textures) {
+			if (binding.second == texture)
+				binding.second = 0;
+		}
+	}
+
+	bool validate() {
+		bool valid = true;
+		check_value("program", program, GL_CURRENT_PROGRAM, valid);
+		check_value("vertex array", vertex_array, GL_VERTEX_ARRAY_BINDING, valid);
+		check_value("framebuffer", framebuffer, GL_FRAMEBUFFER_BINDING, valid);
+		check_value("stencil func", stencil_func, GL_STENCIL_FUNC, valid);
+		check_value("stencil ref", stencil_ref, GL_STENCIL_REF, valid);
+		check_value("stencil value mask", stencil_value_mask == UNKNOWN ? UNKNOWN : (stencil_value_mask & 0xFF), GL_STENCIL_VALUE_MASK, valid);
+		check_value("stencil write mask", stencil_write_mask == UNKNOWN ? UNKNOWN : (stencil_write_mask & 0xFF), GL_STENCIL_WRITEMASK, valid);
+		check_value("stencil fail", stencil_fail, GL_STENCIL_FAIL, valid);
+		check_value("stencil depth fail", stencil_depth_fail, GL_STENCIL_PASS_DEPTH_FAIL, valid);
+		check_value("stencil depth pass", stencil_depth_pass, GL_STENCIL_PASS_DEPTH_PASS, valid);
+		check_value("blend src", blend_src, GL_BLEND_SRC_RGB, valid);
+		check_value("blend dst", blend_dst, GL_BLEND_DST_RGB, valid);
+		check_value("blend src alpha", blend_src_alpha, GL_BLEND_SRC_ALPHA, valid);
+		check_value("blend dst alpha", blend_dst_alpha, GL_BLEND_DST_ALPHA, valid);
+		check_value("depth write mask", depth_write_mask, GL_DEPTH_WRITEMASK, valid);
+
+		for (std::pair < const GLenum, unsigned int >& binding : buffers)
+			check_value("buffer " + std::to_string(binding.first), binding.second, get_buffer_binding(binding.first), valid);
+
+		for (std::pair < const GLenum, unsigned int >& capability : capabilities) {
+			if ((unsigned int)glIsEnabled(capability.first) != capability.second) {
+				std::cout << "ERROR::GL_STATE::VALIDATE\n" << "capability " << capability.first << " cached " << capability.second << " but actual " << (unsigned int)glIsEnabled(capability.first) << ".\n";
+				valid = false;
+			}
+		}
+
+		if (!textures.empty()) {
+			int unit = 0;
+			glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+			check_value("active texture", active_unit == UNKNOWN ? UNKNOWN : GL_TEXTURE0 + active_unit, GL_ACTIVE_TEXTURE, valid);
+
+			for (std::pair < const std::pair < unsigned int, GLenum >, unsigned int >& binding : textures) {
+				glActiveTexture(GL_TEXTURE0 + binding.first.first);
+				check_value("texture unit " + std::to_string(binding.first.first), binding.second, get_texture_binding(binding.first.second), valid);
+			}
+			glActiveTexture(unit);
+		}
+
+		return valid;
+	}
+};
+
+inline thread_local GLState gl_state;
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <GL/glew.h>
+
+
+class GpuTimer {
+	static const int COUNT_FRAMES = 4;
+
+	bool active = false;
+	int free_frame = 0, count_pending = 0;
+	unsigned int queries[2 * COUNT_FRAMES] = { 0 };
+	double time = 0;
+
+public:
+	void create() {
+		glGenQueries(2 * COUNT_FRAMES, queries);
+		free_frame = 0;
+		count_pending = 0;
+		active = false;
+	}
+
+	void begin() {
+		active = queries[0] != 0 && count_pending < COUNT_FRAMES;
+		if (active)
+			glQueryCounter(queries[2 * free_frame], GL_TIMESTAMP);
+	}
+
+	void end() {
+		if (!active)
+			return;
+
+		glQueryCounter(queries[2 * free_frame + 1], GL_TIMESTAMP);
+		free_frame = (free_frame + 1) % COUNT_FRAMES;
+		count_pending++;
+		active = false;
+	}
+
+	bool poll(double& result) {
+		if (count_pending == 0)
+			return false;
+
+		int frame = (free_frame - count_pending + COUNT_FRAMES) % COUNT_FRAMES;
+
+		int available = 0;
+		glGetQueryObjectiv(queries[2 * frame + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+
+		GLuint64 time_begin = 0, time_end = 0;
+		glGetQueryObjectui64v(queries[2 * frame], GL_QUERY_RESULT, &time_begin);
+		glGetQueryObjectui64v(queries[2 * frame + 1], GL_QUERY_RESULT, &time_end);
+		time = ((double)(time_end - time_begin)) / 1000000.0;
+		result = time;
+
+		count_pending--;
+		return true;
+	}
+
+	double get_time() {
+		return time;
+	}
+
+	void destroy() {
+		if (queries[0] == 0)
+			return;
+
+		glDeleteQueries(2 * COUNT_FRAMES, queries);
+		for (int i = 0; i < 2 * COUNT_FRAMES; i++)
+			queries[i] = 0;
+		count_pending = 0;
+	}
+};
@@ -3,23 +3,41 @@
 #include <math.h>
 #include <algorithm>
 #include <iostream>
+#include <string>
 #include <vector>
 #include "GraphObject.h"
 #include "Light.h"
 #include "Kernel.h"
+#include "GpuTimer.h"
+#include "RenderTarget.h"
+#include "RenderStats.h"
+#include "OcclusionCuller.h"
+#include "IndirectRenderer.h"
+#include "SceneGraph.h"
+#include "SceneFrontend.h"
+#include "ResourceLoader.h"
+#include "SceneFile.h"
+#include "ObjectPicker.h"
+#include "AutoExposure.h"
+#include "LightProxies.h"
 #include "CommonClasses/Matrix.h"
 #include "CommonClasses/Random.h"
 
 
+const int TONE_MAP_NONE = 0;
+const int TONE_MAP_REINHARD = 1;
+const int TONE_MAP_ACES = 2;
+
+
 struct TransparentObject {
 	int id;
 	double dist;
 	GraphObject* object;
 
-	TransparentObject(Vect3 cam_position, GraphObject* object, std::pair < Vect3, int > desc) {
+	TransparentObject(GraphObject* object, int id, double dist) {
 		this->object = object;
-		dist = (cam_position - desc.first).length();
-		id = desc.second;
+		this->id = id;
+		this->dist = dist;
 	}
 
 	bool operator <(TransparentObject other) const {
@@ -28,31 +46,69 @@ struct TransparentObject {
 };
 
 
+struct TransparentRun {
+	GraphObject* object;
+	int id, lod, first, count;
+};
+
+
 class GraphEngine {
-	bool grayscale = false;
-	int free_object_id = 0;
-	double gamma = 2.2, kernel_offset = 1.0 / 300.0;
-	Vect3 cam_direction = Vect3(0, 0, 1), cam_horizont = Vect3(1, 0, 0);
+	static constexpr int MAX_OUTLINES = 16, MAX_OUTLINE_RADIUS = 8, MAX_OUTLINE_OBJECTS = 4095;
 
-	unsigned int framebuffer, tex_color_buffer, screen_coord_vao, screen_coord_vbo;
+	bool grayscale = false, dynamic_resolution = false, occlusion_culling = false, indirect_draw = false, gpu_culling = false, picking = false, auto_exposure = false, compact_hdr = false, weighted_transparency = false, light_proxies = true;
+	int free_object_id = 0, render_level = 0, resolution_cooldown = 0, tone_map = TONE_MAP_NONE;
+	unsigned int applied_snapshot = 0, transparent_buffer = 0;
+	double gamma = 2.2, kernel_offset = 1.0 / 300.0, sharpness = 0.5, exposure = 1, exposure_key = 0.18;
+	double render_scale = 1.0, min_render_scale = 0.5, render_scale_step = 0.1, target_frame_time = 1000.0 / 60.0, gpu_frame_time = 0;
+	Vect3 cam_direction = Vect3(0, 0, 1), cam_horizont = Vect3(1, 0, 0), clear_color = Vect3(0.2, 0.3, 0.3);
+
+	unsigned int screen_coord_vao, screen_coord_vbo;
 	double screen_ratio, min_distance, max_distance, fov;
+	std::string shaders_path;
+	sf::Vector2u window_size, headless_size;
 	std::vector < GraphObject > objects;
 	std::vector < Light* > lights;
+	std::vector < float > outline_styles, outline_keys;
+	std::vector < std::unique_ptr < Light > > scene_lights;
+	std::vector < RenderTarget > render_targets;
+	std::vector < SceneNodeTarget > scene_targets;
+	std::vector < std::shared_ptr < PendingObject > > pending_objects;
 	sf::RenderWindow* window;
 	Matrix projection;
 	Kernel kernel;
-	Shader main_shader, post_shader;
+	Shader main_shader, post_shader, depth_shader, cull_shader, exposure_shader, blend_shader, proxy_shader;
+	OcclusionCuller occlusion_culler;
+	IndirectRenderer indirect_renderer;
+	MaterialTable material_table;
+	ObjectPicker object_picker;
+	AutoExposure exposure_meter;
+	LightProxies proxy_renderer;
+	SceneGraph scene_graph;
+	SceneFrontend frontend;
+	ResourceLoader loader;
+	GpuTimer frame_timer, lights_timer, opaque_timer, transparent_timer, post_timer;
+	StatHistory frame_history, lights_history, opaque_history, transparent_history, post_history;
+	StatHistory draw_calls_history, instances_history, triangles_history, uniform_uploads_history, buffer_uploads_history, texture_binds_history, elided_state_calls_history, culled_instances_history;
+	FrameCounters last_frame_counters;
 
 	void init_gl() {
 		glewInit();
-		glViewport(0, 0, window->getSize().x, window->getSize().y);
-		glClearColor(0.2, 0.3, 0.3, 1.0);
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_STENCIL_TEST);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_CULL_FACE);
+		gl_state.invalidate();
+		apply_clear_color();
+		set_gl_state();
+	}
+
+	void apply_clear_color() {
+		glClearColor(pow(clear_color.x, gamma), pow(clear_color.y, gamma), pow(clear_color.z, gamma), clear_color.w);
+	}
+
+	void set_gl_state() {
+		gl_state.set_capability(GL_DEPTH_TEST, true);
+		gl_state.set_capability(GL_STENCIL_TEST, true);
+		gl_state.set_stencil_op(GL_KEEP, GL_KEEP, GL_REPLACE);
+		gl_state.set_capability(GL_BLEND, true);
+		gl_state.set_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		gl_state.set_capability(GL_CULL_FACE, true);
 	}
 
 	void set_uniforms() {
@@ -61,20 +117,27 @@ class GraphEngine {
 		glUniform1i(glGetUniformLocation(main_shader.program, "diffuse_map"), 0);
 		glUniform1i(glGetUniformLocation(main_shader.program, "specular_map"), 1);
 		glUniform1i(glGetUniformLocation(main_shader.program, "emission_map"), 2);
-		glUniform1f(glGetUniformLocation(main_shader.program, "gamma"), gamma);
+		glUniform1i(glGetUniformLocation(main_shader.program, "materials"), 3);
+		glUniform1i(glGetUniformLocation(main_shader.program, "material_table"), 4);
 
 		post_shader.use();
 		kernel.use(&post_shader);
 		glUniform1i(glGetUniformLocation(post_shader.program, "grayscale"), grayscale);
 		glUniform1f(glGetUniformLocation(post_shader.program, "offset"), kernel_offset);
+		glUniform1i(glGetUniformLocation(post_shader.program, "outline_map"), 1);
+		glUniform1i(glGetUniformLocation(post_shader.program, "exposure_map"), 2);
+		set_post_uniforms();
+
+		depth_shader.use();
+		glUniform1i(glGetUniformLocation(depth_shader.program, "depth_map"), 0);
 	}
 
 	void create_screen_coord() {
 		glGenVertexArrays(1, &screen_coord_vao);
-		glBindVertexArray(screen_coord_vao);
+		gl_state.bind_vertex_array(screen_coord_vao);
 
 		glGenBuffers(1, &screen_coord_vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, screen_coord_vbo);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, screen_coord_vbo);
 
 		float vertices[] = {
 			 1,  1, 1, 1,
@@ -91,94 +154,509 @@ class GraphEngine {
 
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)(2 * sizeof(float)));
 		glEnableVertexAttribArray(1);
+	}
+
+	void init(sf::Vector2u size, double fov, double min_distance, double max_distance, std::string shaders_path) {
+		init_gl();
+
+		window_size = size;
+		headless_size = size;
+		this->fov = fov;
+		this->min_distance = min_distance;
+		this->max_distance = max_distance;
+		this->shaders_path = shaders_path;
+		main_shader = Shader(shaders_path + "MainShader", shaders_path + "MainShader");
+		post_shader = Shader(shaders_path + "PostShader", shaders_path + "PostShader");
+		depth_shader = Shader(shaders_path + "PostShader", shaders_path + "DepthShader");
+		proxy_shader = Shader(shaders_path + "ProxyShader", shaders_path + "ProxyShader");
+		lights.resize(main_shader.get_count_lights(), nullptr);
+
+		set_projection();
+
+		create_timers();
+		create_screen_coord();
+		set_uniforms();
+	}
+
+	void set_post_uniforms() {
+		post_shader.use();
+		glUniform1f(glGetUniformLocation(post_shader.program, "gamma"), gamma);
+		glUniform1i(glGetUniformLocation(post_shader.program, "tone_map"), tone_map);
+		glUniform1f(glGetUniformLocation(post_shader.program, "exposure"), exposure);
+		glUniform1i(glGetUniformLocation(post_shader.program, "auto_exposure"), auto_exposure);
+		glUniform1f(glGetUniformLocation(post_shader.program, "exposure_key"), exposure_key);
+	}
+
+	void set_projection() {
+		screen_ratio = ((double)window_size.x) / ((double)window_size.y);
+
+		projection = scale_matrix(Vect3(1 / tan(fov / 2), screen_ratio / tan(fov / 2), (min_distance + max_distance) / (max_distance - min_distance))) * trans_matrix(Vect3(0, 0, -2 * min_distance * max_distance / (min_distance + max_distance)));
+		projection[3][3] = 0;
+		projection[3][2] = 1;
+	}
+
+	void clear_render_targets() {
+		for (RenderTarget& render_target : render_targets)
+			render_target.destroy();
+	}
+
+	int get_count_render_levels() {
+		return std::max((int)((render_scale - min_render_scale) / render_scale_step + 0.000001), 0) + 1;
+	}
+
+	double get_level_scale(int level) {
+		return render_scale - level * render_scale_step;
+	}
+
+	RenderTarget& get_render_target() {
+		render_targets.resize(get_count_render_levels());
+		render_level = std::min(std::max(render_level, 0), (int)render_targets.size() - 1);
+
+		RenderTarget& render_target = render_targets[render_level];
+		if (!render_target.is_created()) {
+			double scale = get_level_scale(render_level);
+			render_target.create(std::max((int)round(window_size.x * scale), 1), std::max((int)round(window_size.y * scale), 1), picking, compact_hdr ? GL_R11F_G11F_B10F : GL_RGBA16F, weighted_transparency);
+		}
+		return render_target;
+	}
+
+	void check_window_size() {
+		sf::Vector2u size = window == nullptr ? headless_size : window->getSize();
+		if (size.x == window_size.x && size.y == window_size.y)
+			return;
+
+		window_size = size;
+		if (window_size.x == 0 || window_size.y == 0)
+			return;
+
+		clear_render_targets();
+		set_projection();
+
+		main_shader.use();
+		glUniformMatrix4fv(glGetUniformLocation(main_shader.program, "projection"), 1, GL_FALSE, projection.value_ptr());
+	}
+
+	void create_timers() {
+		frame_timer.create();
+		lights_timer.create();
+		opaque_timer.create();
+		transparent_timer.create();
+		post_timer.create();
+		occlusion_culler.create();
+		indirect_renderer.create();
+		material_table.create();
+	}
+
+	void delete_timers() {
+		frame_timer.destroy();
+		lights_timer.destroy();
+		opaque_timer.destroy();
+		transparent_timer.destroy();
+		post_timer.destroy();
+		occlusion_culler.destroy();
+		indirect_renderer.destroy();
+		object_picker.destroy();
+		exposure_meter.destroy();
+		proxy_renderer.destroy();
+		material_table.destroy();
+		if (transparent_buffer != 0)
+			gl_state.delete_buffer(transparent_buffer);
+		transparent_buffer = 0;
+	}
+
+	void poll_timer(GpuTimer& timer, StatHistory& history) {
+		double time;
+		while (timer.poll(time))
+			history.push(time);
+	}
+
+	int update_gpu_stats() {
+		int count_frames = 0;
+		double time;
+		while (frame_timer.poll(time)) {
+			frame_history.push(time);
+			gpu_frame_time = gpu_frame_time == 0 ? time : 0.9 * gpu_frame_time + 0.1 * time;
+			count_frames++;
+		}
 
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		poll_timer(lights_timer, lights_history);
+		poll_timer(opaque_timer, opaque_history);
+		poll_timer(transparent_timer, transparent_history);
+		poll_timer(post_timer, post_history);
+		return count_frames;
 	}
 
-	void create_framebuffer() {
-		glGenFramebuffers(1, &framebuffer);
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	void update_frame_stats() {
+		last_frame_counters = frame_counters;
+		draw_calls_history.push(frame_counters.draw_calls);
+		instances_history.push(frame_counters.instances);
+		triangles_history.push(frame_counters.triangles);
+		uniform_uploads_history.push(frame_counters.uniform_uploads);
+		buffer_uploads_history.push(frame_counters.buffer_uploads);
+		texture_binds_history.push(frame_counters.texture_binds);
+		elided_state_calls_history.push(frame_counters.elided_state_calls);
+		culled_instances_history.push(frame_counters.culled_instances);
+		frame_counters = FrameCounters();
+	}
 
-		glGenTextures(1, &tex_color_buffer);
-		glBindTexture(GL_TEXTURE_2D, tex_color_buffer);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, window->getSize().x, window->getSize().y, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
+	void update_render_level(int count_frames) {
+		if (!dynamic_resolution || count_frames == 0)
+			return;
 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_color_buffer, 0);
+		if (resolution_cooldown > 0) {
+			resolution_cooldown = std::max(resolution_cooldown - count_frames, 0);
+			return;
+		}
 
-		unsigned int rbo;
-		glGenRenderbuffers(1, &rbo);
-		glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, window->getSize().x, window->getSize().y);
-		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		int new_level = render_level;
+		if (gpu_frame_time > target_frame_time)
+			new_level = std::min(render_level + 1, get_count_render_levels() - 1);
+		else if (gpu_frame_time < 0.8 * target_frame_time)
+			new_level = std::max(render_level - 1, 0);
 
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+		if (new_level != render_level) {
+			render_level = new_level;
+			resolution_cooldown = 30;
+		}
+	}
 
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-			std::cout << "ERROR::GRAPH_ENGINE::FRAMEBUFFER::\nFramebuffer is not complete.\n";
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	std::vector < GraphObject* > get_objects_by_id() {
+		std::vector < GraphObject* > objects_by_id(free_object_id, nullptr);
+		for (GraphObject& object : objects)
+			objects_by_id[object.id] = &object;
+		return objects_by_id;
 	}
 
-	void draw_lights() {
+	void apply_snapshot() {
+		const SceneSnapshot& snapshot = frontend.acquire();
+		if (snapshot.version == applied_snapshot)
+			return;
+
+		if (snapshot.camera_version > applied_snapshot) {
+			cam_position = Vect3(snapshot.cam_position);
+			cam_direction = Vect3(snapshot.cam_direction);
+			cam_horizont = Vect3(snapshot.cam_horizont);
+		}
+
+		std::vector < GraphObject* > objects_by_id = get_objects_by_id();
+		for (int i = 0; i < snapshot.size(); i++) {
+			if (snapshot.versions[i] <= applied_snapshot)
+				continue;
+
+			int id = snapshot.ids[i];
+			if (snapshot.types[i] == SCENE_NODE)
+				scene_graph.set_local(id, Matrix(snapshot.matrices[i]));
+			else if (0 <= id && id < free_object_id && objects_by_id[id] != nullptr)
+				objects_by_id[id]->set_matrix(Matrix(snapshot.matrices[i]), snapshot.instance_ids[i]);
+		}
+		applied_snapshot = snapshot.version;
+	}
+
+	void update_pending_objects() {
+		for (int i = 0; i < pending_objects.size(); i++) {
+			PendingObject& pending = *pending_objects[i];
+			GLsync fence = pending.fence.load(std::memory_order_acquire);
+			if (fence == 0)
+				continue;
+
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+
+			glDeleteSync(fence);
+			GraphObject& object = (*this)[pending.id];
+			object.swap(*pending.object);
+			object.id = pending.id;
+			object.recreate_vertex_arrays();
+			object.set_shader(&main_shader);
+			outline_keys.clear();
+
+			pending_objects.erase(pending_objects.begin() + i);
+			i--;
+		}
+	}
+
+	void update_scene_graph() {
+		scene_graph.take_changed(scene_targets);
+		if (scene_targets.empty())
+			return;
+
+		std::vector < GraphObject* > objects_by_id = get_objects_by_id();
+		for (const SceneNodeTarget& target : scene_targets) {
+			if (0 <= target.object_id && target.object_id < free_object_id && objects_by_id[target.object_id] != nullptr)
+				objects_by_id[target.object_id]->set_matrix(scene_graph.get_world(target.node), target.instance_id);
+		}
+	}
+
+	void draw_lights(const mat4& view_projection) {
+		lights_timer.begin();
+		proxy_renderer.clear();
 		for (int i = 0; i < lights.size(); i++) {
 			if (lights[i] == nullptr) {
 				draw_default_light(i, &main_shader);
 				continue;
 			}
 
-			lights[i]->draw(i);
+			lights[i]->draw(material_table, i);
+			mat4 model;
+			if (light_proxies && lights[i]->get_proxy(model))
+				proxy_renderer.add(model, lights[i]->proxy_color);
+		}
+
+		if (proxy_renderer.size() > 0) {
+			proxy_renderer.draw(&proxy_shader, view_projection);
+			main_shader.use();
 		}
+		lights_timer.end();
 	}
 
-	void draw_objects() {
-		std::vector < TransparentObject > transparent_objects;
+	void draw_objects(RenderTarget& render_target, const mat4& view_projection) {
+		if (occlusion_culling)
+			occlusion_culler.update();
+
+		opaque_timer.begin();
+		std::vector < GraphObject* > weighted_objects;
+		std::vector < std::pair < GraphObject*, int > > transparent_instances;
+		PointArray transparent_centers;
 		for (GraphObject& object : objects) {
+			bool gpu_driven = gpu_culling && object.can_draw_indirect();
+			object.update_visibility(occlusion_culling && !gpu_driven ? &occlusion_culler : nullptr);
+			object.update_lods(cam_position, screen_ratio / tan(fov / 2));
+
+			if (object.transparent && weighted_transparency) {
+				weighted_objects.push_back(&object);
+				continue;
+			}
 			if (object.transparent) {
-				for (std::pair < Vect3, int > el : object.get_objects())
-					transparent_objects.push_back(TransparentObject(cam_position, &object, el));
+				for (std::pair < Vect3, int > el : object.get_objects()) {
+					if (!object.is_visible(el.second))
+						continue;
+
+					transparent_instances.push_back({ &object, el.second });
+					transparent_centers.x.push_back(el.first.x);
+					transparent_centers.y.push_back(el.first.y);
+					transparent_centers.z.push_back(el.first.z);
+				}
 				continue;
 			}
 
-			object.draw(cam_position);
+			if (indirect_draw && object.can_draw_indirect())
+				continue;
+
+			object.draw(material_table);
+		}
+		if (indirect_draw)
+			indirect_renderer.draw(objects, &main_shader, material_table, view_projection, occlusion_culling ? occlusion_culler.get_pyramid() : DepthPyramid());
+		opaque_timer.end();
+
+		if (occlusion_culling) {
+			occlusion_culler.build(render_target, &depth_shader, screen_coord_vao, view_projection);
+			gl_state.bind_framebuffer(render_target.framebuffer);
+			glViewport(0, 0, render_target.width, render_target.height);
+			main_shader.use();
 		}
 
+		std::vector < float > distances(transparent_instances.size());
+		get_distances_sqr(transparent_centers.span(), cam_position.get_vec3(), distances.data());
+
+		std::vector < TransparentObject > transparent_objects;
+		for (int i = 0; i < transparent_instances.size(); i++)
+			transparent_objects.push_back(TransparentObject(transparent_instances[i].first, transparent_instances[i].second, distances[i]));
+
+		transparent_timer.begin();
+		draw_weighted_objects(render_target, weighted_objects);
 		std::sort(transparent_objects.rbegin(), transparent_objects.rend());
-		for (TransparentObject object : transparent_objects)
-			object.object->draw(cam_position, object.id);
+		bool outline_mask = true;
+		std::vector < TransparentRun > runs = get_transparent_runs(transparent_objects);
+		for (TransparentRun run : runs) {
+			if (run.object->border != outline_mask) {
+				outline_mask = run.object->border;
+				glColorMaski(2, outline_mask, outline_mask, outline_mask, outline_mask);
+			}
+
+			if (run.first < 0)
+				run.object->draw(material_table, run.id);
+			else
+				run.object->draw_instances(material_table, transparent_buffer, run.first, run.count, run.lod);
+		}
+		for (TransparentRun run : runs)
+			run.object->restore_matrix_buffers();
+		if (!outline_mask)
+			glColorMaski(2, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		transparent_timer.end();
+	}
+
+	std::vector < TransparentRun > get_transparent_runs(const std::vector < TransparentObject >& transparent_objects) {
+		std::vector < TransparentRun > runs;
+		std::vector < float > rows;
+		for (int begin = 0, end = 0; begin < transparent_objects.size(); begin = end) {
+			GraphObject* object = transparent_objects[begin].object;
+			int lod = object->get_lod(transparent_objects[begin].id);
+			for (end = begin + 1; end < transparent_objects.size(); end++) {
+				if (transparent_objects[end].object != object || object->get_lod(transparent_objects[end].id) != lod)
+					break;
+			}
+
+			if (end - begin == 1) {
+				runs.push_back({ object, transparent_objects[begin].id, lod, -1, 1 });
+				continue;
+			}
+
+			runs.push_back({ object, -1, lod, (int)rows.size() / INSTANCE_SIZE, end - begin });
+			const float* instance_rows = object->get_instance_rows().data();
+			for (int i = begin; i < end; i++)
+				rows.insert(rows.end(), instance_rows + INSTANCE_SIZE * transparent_objects[i].id, instance_rows + INSTANCE_SIZE * (transparent_objects[i].id + 1));
+		}
+
+		if (!rows.empty()) {
+			if (transparent_buffer == 0)
+				glGenBuffers(1, &transparent_buffer);
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, transparent_buffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * rows.size(), rows.data(), GL_STREAM_DRAW);
+			frame_counters.buffer_uploads++;
+		}
+		return runs;
+	}
+
+	void draw_weighted_objects(RenderTarget& render_target, const std::vector < GraphObject* >& weighted_objects) {
+		if (weighted_objects.empty())
+			return;
+
+		render_target.set_draw_buffers(true);
+		render_target.clear_weighted_buffers();
+		gl_state.set_depth_mask(false);
+		gl_state.set_blend_func_separate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+		glUniform1i(glGetUniformLocation(main_shader.program, "weighted_blend"), true);
+		frame_counters.uniform_uploads++;
+
+		bool outline_mask = true;
+		for (GraphObject* object : weighted_objects) {
+			if (object->border != outline_mask) {
+				outline_mask = object->border;
+				glColorMaski(2, outline_mask, outline_mask, outline_mask, outline_mask);
+			}
+			object->draw(material_table);
+		}
+		if (!outline_mask)
+			glColorMaski(2, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		glUniform1i(glGetUniformLocation(main_shader.program, "weighted_blend"), false);
+		gl_state.set_depth_mask(true);
+		gl_state.set_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		render_target.set_draw_buffers(false, false);
+
+		blend_shader.use();
+		gl_state.set_capability(GL_DEPTH_TEST, false);
+		gl_state.bind_vertex_array(screen_coord_vao);
+		gl_state.bind_texture_unit(0, GL_TEXTURE_2D, render_target.accum_buffer);
+		gl_state.bind_texture_unit(1, GL_TEXTURE_2D, render_target.weight_buffer);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+		frame_counters.uniform_uploads++;
+		frame_counters.draw_calls++;
+		frame_counters.instances++;
+		frame_counters.triangles += 2;
+
+		gl_state.bind_texture_unit(0, GL_TEXTURE_2D, 0);
+		gl_state.bind_texture_unit(1, GL_TEXTURE_2D, 0);
+		gl_state.set_capability(GL_DEPTH_TEST, true);
+		render_target.set_draw_buffers(false);
+		main_shader.use();
+	}
+
+	void update_outlines() {
+		std::vector < float > keys;
+		for (GraphObject& object : objects) {
+			if (!object.border)
+				continue;
+
+			Vect3 color = object.get_border_color();
+			keys.insert(keys.end(), { (float)object.id, (float)color.x, (float)color.y, (float)color.z, (float)object.border_width });
+		}
+		if (keys == outline_keys)
+			return;
+		outline_keys = keys;
+
+		outline_styles.clear();
+		int count_outlined = 0;
+		for (GraphObject& object : objects) {
+			if (!object.border)
+				continue;
+
+			Vect3 color = object.get_border_color();
+			float style[] = { (float)color.x, (float)color.y, (float)color.z, (float)object.border_width };
+			int index = 0;
+			while (index < outline_styles.size() && !std::equal(style, style + 4, outline_styles.begin() + index))
+				index += 4;
+			if (index == outline_styles.size() && index < 4 * MAX_OUTLINES)
+				outline_styles.insert(outline_styles.end(), style, style + 4);
+
+			int slot = count_outlined++ % MAX_OUTLINE_OBJECTS + 1;
+			object.set_outline_id(index < outline_styles.size() ? slot * MAX_OUTLINES + index / 4 : 0);
+		}
 	}
 
-	void draw_framebuffer() {
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	void draw_framebuffer(RenderTarget& render_target) {
+		gl_state.bind_framebuffer(render_target.framebuffer);
+		glViewport(0, 0, render_target.width, render_target.height);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		render_target.clear_id_buffers();
 		main_shader.use();
+		gl_state.bind_texture_unit(4, GL_TEXTURE_BUFFER, material_table.get_texture());
 
 		Matrix view = Matrix(cam_horizont, cam_direction ^ cam_horizont, cam_direction).transp() * trans_matrix(-cam_position);
 		glUniformMatrix4fv(glGetUniformLocation(main_shader.program, "view"), 1, GL_FALSE, view.value_ptr());
 		
 		glUniform3f(glGetUniformLocation(main_shader.program, "view_pos"), cam_position.x, cam_position.y, cam_position.z);
+		frame_counters.uniform_uploads += 2;
 
-		draw_lights();
-		draw_objects();
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		mat4 view_projection = (projection * view).get_mat4();
+		draw_lights(view_projection);
+		update_outlines();
+		draw_objects(render_target, view_projection);
 	}
 
-	void draw_mainbuffer() {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	void draw_mainbuffer(RenderTarget& render_target) {
+		gl_state.bind_framebuffer(0);
+		glViewport(0, 0, window_size.x, window_size.y);
 		glClear(GL_COLOR_BUFFER_BIT);
 		post_shader.use();
-		glDisable(GL_DEPTH_TEST);
+		gl_state.set_capability(GL_DEPTH_TEST, false);
+
+		glUniform1f(glGetUniformLocation(post_shader.program, "sharpness"), render_target.width < (int)window_size.x ? sharpness : 0.0);
+		glUniform2f(glGetUniformLocation(post_shader.program, "texel_size"), 1.0 / render_target.width, 1.0 / render_target.height);
+		frame_counters.uniform_uploads += 2;
+
+		std::vector < float > styles = outline_styles;
+		double outline_scale = (double)render_target.width / window_size.x, outline_radius = 0;
+		for (int i = 3; i < styles.size(); i += 4) {
+			styles[i] *= outline_scale;
+			outline_radius = std::max(outline_radius, (double)styles[i]);
+		}
+		glUniform1i(glGetUniformLocation(post_shader.program, "outline_radius"), std::min((int)ceil(outline_radius), MAX_OUTLINE_RADIUS));
+		frame_counters.uniform_uploads++;
+		if (!styles.empty()) {
+			glUniform4fv(glGetUniformLocation(post_shader.program, "outline_styles"), styles.size() / 4, styles.data());
+			gl_state.bind_texture_unit(1, GL_TEXTURE_2D, render_target.outline_buffer);
+			frame_counters.uniform_uploads++;
+		}
+		if (auto_exposure)
+			gl_state.bind_texture_unit(2, GL_TEXTURE_2D, exposure_meter.get_texture());
 
-		glBindVertexArray(screen_coord_vao);
-		glBindTexture(GL_TEXTURE_2D, tex_color_buffer);
+		gl_state.bind_vertex_array(screen_coord_vao);
+		gl_state.bind_texture_unit(0, GL_TEXTURE_2D, render_target.tex_color_buffer);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 
-		glEnable(GL_DEPTH_TEST);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glBindVertexArray(0);
+		frame_counters.draw_calls++;
+		frame_counters.instances++;
+		frame_counters.triangles += 2;
+
+		gl_state.set_capability(GL_DEPTH_TEST, true);
+		gl_state.bind_texture_unit(0, GL_TEXTURE_2D, 0);
+		if (!styles.empty())
+			gl_state.bind_texture_unit(1, GL_TEXTURE_2D, 0);
+		if (auto_exposure)
+			gl_state.bind_texture_unit(2, GL_TEXTURE_2D, 0);
 	}
 
 public:
@@ -192,9 +670,18 @@ public:
 		screen_ratio = object.screen_ratio;
 		min_distance = object.min_distance;
 		max_distance = object.max_distance;
-		objects = object.objects;
+		objects.reserve(object.objects.size());
+		for (const GraphObject& source : object.objects) {
+			bool pending = false;
+			for (const std::shared_ptr < PendingObject >& loading : object.pending_objects)
+				pending |= loading->id == source.id;
+			if (!pending)
+				objects.push_back(source);
+		}
 		lights = object.lights;
 		window = object.window;
+		shaders_path = object.shaders_path;
+		headless_size = object.headless_size;
 		main_shader = object.main_shader;
 		post_shader = object.post_shader;
 		grayscale = object.grayscale;
@@ -203,32 +690,61 @@ public:
 		fov = object.fov;
 		kernel = object.kernel;
 		projection = object.projection;
+		window_size = object.window_size;
+		dynamic_resolution = object.dynamic_resolution;
+		render_level = object.render_level;
+		sharpness = object.sharpness;
+		render_scale = object.render_scale;
+		min_render_scale = object.min_render_scale;
+		render_scale_step = object.render_scale_step;
+		target_frame_time = object.target_frame_time;
+		occlusion_culling = object.occlusion_culling;
+		indirect_draw = object.indirect_draw;
+		gpu_culling = object.gpu_culling;
+		picking = object.picking;
+		scene_graph = object.scene_graph;
+		cull_shader = object.cull_shader;
+		depth_shader = object.depth_shader;
+		exposure_shader = object.exposure_shader;
+		blend_shader = object.blend_shader;
+		proxy_shader = object.proxy_shader;
+		light_proxies = object.light_proxies;
+		weighted_transparency = object.weighted_transparency;
+		tone_map = object.tone_map;
+		exposure = object.exposure;
+		exposure_key = object.exposure_key;
+		auto_exposure = object.auto_exposure;
+		compact_hdr = object.compact_hdr;
+		clear_color = object.clear_color;
+
+		for (GraphObject& copy : objects) {
+			if (copy.get_shader() == &object.main_shader)
+				copy.set_shader(&main_shader);
+		}
+
+		for (const std::unique_ptr < Light >& light : object.scene_lights) {
+			scene_lights.push_back(std::unique_ptr < Light >(light->clone()));
+			for (int i = 0; i < lights.size(); i++) {
+				if (lights[i] == light.get())
+					set_light(i, scene_lights.back().get());
+			}
+		}
 
-		create_framebuffer();
+		create_timers();
 		create_screen_coord();
 		set_uniforms();
+		indirect_renderer.set_cull_shader(gpu_culling ? &cull_shader : nullptr);
 	}
 
-	GraphEngine(sf::RenderWindow* window, double fov, double min_distance, double max_distance) {
+	GraphEngine(sf::RenderWindow* window, double fov, double min_distance, double max_distance, std::string shaders_path = "GraphEngine/Shaders/") {
 		this->window = window;
 		window->setActive(true);
-		init_gl();
-
-		screen_ratio = ((double)window->getSize().x) / ((double)window->getSize().y);
-		this->fov = fov;
-		this->min_distance = min_distance;
-		this->max_distance = max_distance;
-		main_shader = Shader("GraphEngine/Shaders/MainShader", "GraphEngine/Shaders/MainShader");
-		post_shader = Shader("GraphEngine/Shaders/PostShader", "GraphEngine/Shaders/PostShader");
-		lights.resize(main_shader.get_count_lights(), nullptr);
-
-		projection = scale_matrix(Vect3(1 / tan(fov / 2), screen_ratio / tan(fov / 2), (min_distance + max_distance) / (max_distance - min_distance))) * trans_matrix(Vect3(0, 0, -2 * min_distance * max_distance / (min_distance + max_distance)));
-		projection[3][3] = 0;
-		projection[3][2] = 1;
+		init(window->getSize(), fov, min_distance, max_distance, shaders_path);
+	}
 
-		create_framebuffer();
-		create_screen_coord();
-		set_uniforms();
+	GraphEngine(int width, int height, double fov, double min_distance, double max_distance, std::string shaders_path = "GraphEngine/Shaders/") {
+		window = nullptr;
+		init(sf::Vector2u(width, height), fov, min_distance, max_distance, shaders_path);
 	}
 
 	GraphObject& operator[](int id) {
@@ -241,7 +757,46 @@ public:
 	}
 
 	void set_clear_color(Vect3 color) {
-		glClearColor(color.x, color.y, color.z, color.w);
+		clear_color = color;
+		apply_clear_color();
+	}
+
+	void set_gamma(double gamma) {
+		if (gamma <= 0) {
+			std::cout << "ERROR::GRAPH_ENGINE::SET_GAMMA\nGamma must be positive.\n";
+			return;
+		}
+
+		this->gamma = gamma;
+		apply_clear_color();
+		set_post_uniforms();
+	}
+
+	void set_tone_mapping(int tone_map, double exposure = 1) {
+		this->tone_map = tone_map;
+		this->exposure = exposure;
+		set_post_uniforms();
+	}
+
+	void set_auto_exposure(bool auto_exposure, double exposure_key = 0.18, double adaptation_speed = 1.5) {
+		if (auto_exposure && exposure_shader.program == 0) {
+			exposure_shader = Shader(shaders_path + "PostShader", shaders_path + "ExposureShader");
+			exposure_shader.use();
+			glUniform1i(glGetUniformLocation(exposure_shader.program, "screen_texture"), 0);
+			glUniform1i(glGetUniformLocation(exposure_shader.program, "luminance_map"), 1);
+			glUniform1i(glGetUniformLocation(exposure_shader.program, "adapted_map"), 2);
+		}
+
+		this->auto_exposure = auto_exposure;
+		this->exposure_key = exposure_key;
+		exposure_meter.set_adaptation_speed(adaptation_speed);
+		exposure_meter.reset();
+		set_post_uniforms();
+	}
+
+	void set_compact_hdr(bool compact_hdr) {
+		this->compact_hdr = compact_hdr;
+		clear_render_targets();
 	}
 
 	void set_light(int id, Light* new_light) {
@@ -269,6 +824,155 @@ public:
 		glUniform1f(glGetUniformLocation(post_shader.program, "offset"), kernel_offset);
 	}
 
+	void set_window_size(int width, int height) {
+		headless_size = sf::Vector2u(width, height);
+	}
+
+	void set_render_scale(double render_scale) {
+		if (render_scale <= 0) {
+			std::cout << "ERROR::GRAPH_ENGINE::SET_RENDER_SCALE\nRender scale must be positive.\n";
+			return;
+		}
+
+		this->render_scale = render_scale;
+		clear_render_targets();
+	}
+
+	void set_min_render_scale(double min_render_scale) {
+		this->min_render_scale = std::max(min_render_scale, render_scale_step);
+		clear_render_targets();
+	}
+
+	void set_dynamic_resolution(bool dynamic_resolution, double target_frame_time = 1000.0 / 60.0) {
+		this->dynamic_resolution = dynamic_resolution;
+		this->target_frame_time = target_frame_time;
+		resolution_cooldown = 0;
+		if (!dynamic_resolution)
+			render_level = 0;
+	}
+
+	void set_occlusion_culling(bool occlusion_culling, int readback_size = 256) {
+		this->occlusion_culling = occlusion_culling;
+		occlusion_culler.clear();
+		occlusion_culler.set_readback_size(readback_size);
+	}
+
+	void set_indirect_draw(bool indirect_draw) {
+		if (indirect_draw && !IndirectRenderer::is_supported()) {
+			std::cout << "ERROR::GRAPH_ENGINE::SET_INDIRECT_DRAW\nMulti-draw indirect requires OpenGL 4.3.\n";
+			return;
+		}
+
+		this->indirect_draw = indirect_draw;
+		if (!indirect_draw)
+			set_gpu_culling(false);
+	}
+
+	void set_gpu_culling(bool gpu_culling) {
+		if (gpu_culling && !IndirectRenderer::is_compute_supported()) {
+			std::cout << "ERROR::GRAPH_ENGINE::SET_GPU_CULLING\nCompute shaders require OpenGL 4.3.\n";
+			return;
+		}
+
+		if (gpu_culling) {
+			set_indirect_draw(true);
+			if (!indirect_draw)
+				return;
+			if (cull_shader.program == 0)
+				cull_shader = Shader(shaders_path + "CullShader");
+		}
+
+		this->gpu_culling = gpu_culling;
+		indirect_renderer.set_cull_shader(gpu_culling ? &cull_shader : nullptr);
+	}
+
+	void set_light_proxies(bool light_proxies) {
+		this->light_proxies = light_proxies;
+	}
+
+	void set_weighted_transparency(bool weighted_transparency) {
+		if (this->weighted_transparency == weighted_transparency)
+			return;
+
+		if (weighted_transparency && blend_shader.program == 0) {
+			blend_shader = Shader(shaders_path + "PostShader", shaders_path + "BlendShader");
+			blend_shader.use();
+			glUniform1i(glGetUniformLocation(blend_shader.program, "accum_map"), 0);
+			glUniform1i(glGetUniformLocation(blend_shader.program, "weight_map"), 1);
+		}
+
+		this->weighted_transparency = weighted_transparency;
+		clear_render_targets();
+	}
+
+	void set_picking(bool picking) {
+		if (this->picking == picking)
+			return;
+
+		this->picking = picking;
+		object_picker.clear();
+		clear_render_targets();
+	}
+
+	int pick_rect(int x, int y, int width, int height) {
+		if (!picking) {
+			std::cout << "ERROR::GRAPH_ENGINE::PICK_RECT\nPicking is disabled.\n";
+			return -1;
+		}
+
+		return object_picker.request(x, y, width, height);
+	}
+
+	int pick(int x, int y) {
+		return pick_rect(x, y, 1, 1);
+	}
+
+	bool get_pick_result(int request_id, std::vector < PickResult >& result) {
+		return object_picker.take_result(request_id, result);
+	}
+
+	void set_sharpness(double sharpness) {
+		this->sharpness = sharpness;
+	}
+
+	double get_render_scale() {
+		return get_level_scale(render_level);
+	}
+
+	double get_gpu_frame_time() {
+		return gpu_frame_time;
+	}
+
+	void set_stats_window(int count_frames) {
+		update_gpu_stats();
+		frame_history = lights_history = opaque_history = transparent_history = post_history = StatHistory(count_frames);
+		draw_calls_history = instances_history = triangles_history = StatHistory(count_frames);
+		uniform_uploads_history = buffer_uploads_history = texture_binds_history = elided_state_calls_history = culled_instances_history = StatHistory(count_frames);
+	}
+
+	RenderStats get_stats() {
+		RenderStats stats;
+		stats.gpu_frame = frame_history.get();
+		stats.gpu_lights = lights_history.get();
+		stats.gpu_opaque = opaque_history.get();
+		stats.gpu_transparent = transparent_history.get();
+		stats.gpu_post = post_history.get();
+		stats.draw_calls = draw_calls_history.get();
+		stats.instances = instances_history.get();
+		stats.triangles = triangles_history.get();
+		stats.uniform_uploads = uniform_uploads_history.get();
+		stats.buffer_uploads = buffer_uploads_history.get();
+		stats.texture_binds = texture_binds_history.get();
+		stats.elided_state_calls = elided_state_calls_history.get();
+		stats.culled_instances = culled_instances_history.get();
+		stats.last_frame = last_frame_counters;
+		return stats;
+	}
+
+	void set_gl_state_debug(bool debug) {
+		gl_state.debug = debug;
+	}
+
 	Shader* get_main_shader() {
 		return &main_shader;
 	}
@@ -294,6 +998,14 @@ public:
 		return cam_direction ^ cam_horizont;
 	}
 
+	SceneGraph& get_scene_graph() {
+		return scene_graph;
+	}
+
+	SceneFrontend& get_frontend() {
+		return frontend;
+	}
+
 	int add_object(GraphObject object) {
 		objects.push_back(object);
 		objects.back().set_shader(&main_shader);
@@ -301,10 +1013,96 @@ public:
 		return objects.back().id;
 	}
 
+	int load_object(std::function < GraphObject() > builder) {
+		objects.push_back(GraphObject());
+		objects.back().id = free_object_id++;
+		pending_objects.push_back(loader.load_object(objects.back().id, builder));
+		return objects.back().id;
+	}
+
+	bool save_scene(std::string path) {
+		SceneFileWriter writer;
+		writer.set_camera(cam_position, cam_direction, cam_horizont);
+		for (GraphObject& object : objects)
+			writer.add_object(object);
+		for (Light* light : lights)
+			writer.add_light(light);
+		return writer.save(path);
+	}
+
+	bool load_scene(std::string path) {
+		SceneFile file;
+		if (!file.open(path))
+			return false;
+
+		for (std::unique_ptr < Light >& light : scene_lights) {
+			for (int i = 0; i < lights.size(); i++) {
+				if (lights[i] == light.get())
+					lights[i] = nullptr;
+			}
+		}
+		scene_lights.clear();
+
+		const SceneFileHeader& header = file.get_header();
+		cam_position = read_vect3(header.cam_position);
+		cam_direction = read_vect3(header.cam_direction);
+		cam_horizont = read_vect3(header.cam_horizont);
+
+		std::map < std::string, Texture > textures;
+		objects.reserve(objects.size() + header.count_objects);
+		for (uint32_t i = 0; i < header.count_objects; i++) {
+			objects.emplace_back(file.get_object(i).max_count_models, &main_shader);
+			objects.back().id = free_object_id++;
+			file.read_object(i, objects.back(), textures);
+		}
+
+		for (int i = 0; i < lights.size() && i < header.count_lights; i++) {
+			Light* light = file.create_light(i);
+			if (light != nullptr)
+				scene_lights.push_back(std::unique_ptr < Light >(light));
+			set_light(i, light);
+		}
+		return true;
+	}
+
+	bool is_object_ready(int id) {
+		for (std::shared_ptr < PendingObject >& pending : pending_objects) {
+			if (pending->id == id)
+				return false;
+		}
+		return true;
+	}
+
 	void draw() {
-		window->setActive(true);
-		draw_framebuffer();
-		draw_mainbuffer();
+		if (window != nullptr)
+			window->setActive(true);
+		gl_state.invalidate();
+		set_gl_state();
+		check_window_size();
+		if (window_size.x == 0 || window_size.y == 0)
+			return;
+
+		update_render_level(update_gpu_stats());
+
+		object_picker.update();
+		update_pending_objects();
+		apply_snapshot();
+		update_scene_graph();
+
+		RenderTarget& render_target = get_render_target();
+		frame_timer.begin();
+		draw_framebuffer(render_target);
+		if (picking)
+			object_picker.read(render_target, window_size.x, window_size.y);
+
+		post_timer.begin();
+		if (auto_exposure)
+			exposure_meter.update(render_target, &exposure_shader, screen_coord_vao);
+		draw_mainbuffer(render_target);
+		post_timer.end();
+		frame_timer.end();
+
+		update_frame_stats();
 	}
 
 	void rotate_cam(Vect3 axis, double angle) {
@@ -314,9 +1112,14 @@ public:
 	}
 
 	~GraphEngine() {
-		glDeleteVertexArrays(1, &screen_coord_vao);
-		glDeleteBuffers(1, &screen_coord_vbo);
-		glDeleteFramebuffers(1, &framebuffer);
-		glDeleteTextures(1, &tex_color_buffer);
+		loader.stop();
+		for (std::shared_ptr < PendingObject >& pending : pending_objects) {
+			if (pending->fence.load() != 0)
+				glDeleteSync(pending->fence.load());
+		}
+		gl_state.delete_vertex_array(screen_coord_vao);
+		gl_state.delete_buffer(screen_coord_vbo);
+		clear_render_targets();
+		delete_timers();
 	}
 };
@@ -3,116 +3,254 @@
 #include <iostream>
 #include <vector>
 #include "Polygon.h"
+#include "MeshSimplifier.h"
+#include "InstanceStorage.h"
+#include "OcclusionCuller.h"
 #include "CommonClasses/Matrix.h"
 
 
+struct LodLevel {
+	int count_instances = 0;
+	unsigned int matrix_buffer = 0;
+	double screen_size = INFINITY;
+	std::vector < float > instances;
+	std::vector < Polygon > polygons;
+};
+
+
 class GraphObject {
-	int free_polygon_id = 0, count_points = 0;
+	int free_polygon_id = 0, count_points = 0, outline_id = 0;
 	Vect3 center = Vect3(0, 0, 0), border_color = Vect3(1, 0, 0);
-	std::vector < Matrix > models = std::vector < Matrix >(1, one_matrix(4));
+	InstanceStorage instances;
+
+	double radius = 0, lod_hysteresis = 0.1;
+	int lod_revision = -1;
+	vec3 bounds_min, bounds_max;
+	std::vector < int > bounds_key;
+	std::vector < LodLevel > lods;
+	std::vector < float > lod_distances;
+
+	bool culling = false, visibility_dirty = false, streamed_instances = false;
+	int count_visible = 0, instance_revision = 0;
+	unsigned int visible_buffer = 0;
+	std::vector < float > visible_instances;
 
 	int max_count_models;
 	unsigned int matrix_buffer;
 	std::vector < Polygon > polygons;
 	Shader* shader_program;
 
-	void set_uniforms() {
-		if (shader_program == nullptr)
-			return;
-
-		shader_program->use();
-		glUniform3f(glGetUniformLocation(shader_program->program, "border_color"), border_color.x, border_color.y, border_color.z);
-	}
+	void draw_polygons(MaterialTable& material_table, int id) {
+		flush_instances();
 
-	void draw_polygons(int id) {
-		int cnt = models.size();
+		int cnt = instances.size();
 		if (id != -1) {
-			glUniformMatrix4fv(glGetUniformLocation(shader_program->program, "not_instance_model"), 1, GL_FALSE, models[id].value_ptr());
+			glUniformMatrix4fv(glGetUniformLocation(shader_program->program, "not_instance_model"), 1, GL_FALSE, instances.get_row(id));
+			glUniformMatrix3fv(glGetUniformLocation(shader_program->program, "not_instance_normal"), 1, GL_FALSE, instances.get_row(id) + 16);
+			glUniform1i(glGetUniformLocation(shader_program->program, "not_instance_index"), id);
+			frame_counters.uniform_uploads += 3;
 			cnt = 1;
 		}
 
 		glUniform1i(glGetUniformLocation(shader_program->program, "use_instance"), id == -1);
+		glUniform1i(glGetUniformLocation(shader_program->program, "pick_object"), this->id);
+		glUniform1i(glGetUniformLocation(shader_program->program, "outline_id"), get_outline_id());
+		frame_counters.uniform_uploads += 3;
+
+		if (lods.empty()) {
+			if (id == -1 && culling) {
+				update_visible_buffer();
+				cnt = count_visible;
+			}
+			if (cnt == 0)
+				return;
 
-		for (Polygon& polygon : polygons) {
-			polygon.set_uniforms();
-			polygon.draw(cnt);
-			polygon.delete_uniforms();
+			for (Polygon& polygon : polygons) {
+				polygon.set_uniforms(material_table);
+				polygon.draw(cnt);
+			}
+			return;
 		}
-	}
 
-	void draw_border(Vect3 view_pos, int id) {
-		if (id != -1) {
-			Matrix model_border = models[id] * scale_matrix(1 + border_width * (view_pos - models[id] * center).length());
-			glUniformMatrix4fv(glGetUniformLocation(shader_program->program, "not_instance_model"), 1, GL_FALSE, model_border.value_ptr());
+		for (int i = 0; i < lods.size(); i++) {
+			if (id != -1 && i != instances.lods[id])
+				continue;
+			if (id == -1 && lods[i].count_instances == 0)
+				continue;
+
+			for (Polygon& polygon : lods[i].polygons) {
+				polygon.set_uniforms(material_table);
+				polygon.draw(id == -1 ? lods[i].count_instances : 1);
+			}
 		}
+	}
+
+	void create_matrix_buffer() {
+		glGenBuffers(1, &matrix_buffer);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, matrix_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * INSTANCE_SIZE * max_count_models, NULL, GL_STATIC_DRAW);
+		frame_counters.buffer_uploads++;
+
+		for (Polygon& polygon : polygons)
+			polygon.set_matrix_buffer(matrix_buffer);
+	}
 
-		glUniform1i(glGetUniformLocation(shader_program->program, "use_instance"), 0);
-		glUniform1i(glGetUniformLocation(shader_program->program, "border"), 1);
+	int add_instance(const mat4& model) {
+		int id = instances.add(model, center.get_vec3());
+		visibility_dirty = true;
+		instance_revision++;
+		return id;
+	}
 
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glStencilMask(0x00);
+	void set_instance(int id, const mat4& model) {
+		instances.set(id, model, center.get_vec3());
+		visibility_dirty = true;
+		instance_revision++;
+	}
 
-		for (Polygon& polygon : polygons) {
-			polygon.set_uniforms();
-			if (id == -1) {
-				for (Matrix& model : models) {
-					Matrix model_border = model * scale_matrix(1 + border_width * (view_pos - model * center).length());
-					glUniformMatrix4fv(glGetUniformLocation(shader_program->program, "not_instance_model"), 1, GL_FALSE, model_border.value_ptr());
-					polygon.draw(1);
-				}
-			}
-			else {
-				polygon.draw(1);
-			}
-			polygon.delete_uniforms();
+	void flush_instances() {
+		if (!instances.has_dirty())
+			return;
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, matrix_buffer);
+		instances.take_dirty_ranges([&](int begin, int end) {
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * INSTANCE_SIZE * begin, sizeof(float) * INSTANCE_SIZE * (end - begin), instances.get_row(begin));
+			frame_counters.buffer_uploads++;
+		});
+	}
+
+	void update_visible_buffer() {
+		if (!visibility_dirty)
+			return;
+
+		count_visible = 0;
+		visible_instances.resize(INSTANCE_SIZE * instances.size());
+		for (int i = 0; i < instances.size(); i++) {
+			if (instances.is_culled(i))
+				continue;
+
+			std::copy(instances.get_row(i), instances.get_row(i + 1), visible_instances.begin() + INSTANCE_SIZE * count_visible);
+			count_visible++;
 		}
 
-		glStencilFunc(GL_ALWAYS, 0, 0xFF);
-		glStencilMask(0xFF);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, visible_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * INSTANCE_SIZE * count_visible, visible_instances.data());
+		frame_counters.buffer_uploads++;
+		visibility_dirty = false;
+	}
+
+	void enable_culling() {
+		if (visible_buffer == 0) {
+			glGenBuffers(1, &visible_buffer);
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, visible_buffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * INSTANCE_SIZE * max_count_models, NULL, GL_STREAM_DRAW);
+			frame_counters.buffer_uploads++;
+		}
 
-		glUniform1i(glGetUniformLocation(shader_program->program, "border"), 0);
+		for (Polygon& polygon : polygons)
+			polygon.set_matrix_buffer(visible_buffer);
+		culling = true;
+		visibility_dirty = true;
 	}
 
-	void create_matrix_buffer() {
-		glGenBuffers(1, &matrix_buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, matrix_buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 16 * max_count_models, NULL, GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	void clear_visibility() {
+		if (!culling)
+			return;
 
+		culling = false;
+		for (int i = 0; i < instances.size(); i++)
+			instances.set_culled(i, false);
+		instance_revision++;
 		for (Polygon& polygon : polygons)
 			polygon.set_matrix_buffer(matrix_buffer);
 	}
 
+	bool same_surface(Polygon& polygon, Polygon& other) {
+		Material& material = polygon.material;
+		Material& other_material = other.material;
+		return material.light == other_material.light && material.shininess == other_material.shininess && material.alpha == other_material.alpha
+			&& material.ambient == other_material.ambient && material.diffuse == other_material.diffuse && material.specular == other_material.specular && material.emission == other_material.emission
+			&& polygon.diffuse_map.texture_id == other.diffuse_map.texture_id && polygon.specular_map.texture_id == other.specular_map.texture_id && polygon.emission_map.texture_id == other.emission_map.texture_id;
+	}
+
+	void create_lod_buffer(LodLevel& level) {
+		glGenBuffers(1, &level.matrix_buffer);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, level.matrix_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * INSTANCE_SIZE * max_count_models, NULL, GL_STREAM_DRAW);
+		frame_counters.buffer_uploads++;
+
+		for (Polygon& polygon : level.polygons)
+			polygon.set_matrix_buffer(level.matrix_buffer);
+		lod_revision = -1;
+	}
+
+	void set_radius() {
+		set_center();
+
+		radius = 0;
+		for (Polygon& polygon : polygons) {
+			std::vector < float > positions = polygon.get_positions();
+			for (int i = 0; i < positions.size(); i += 3)
+				radius = std::max(radius, (Vect3(positions[i], positions[i + 1], positions[i + 2]) - center).length());
+		}
+	}
+
+	bool is_bounds_dirty() {
+		if (bounds_key.size() != 2 * polygons.size())
+			return true;
+
+		for (int i = 0; i < polygons.size(); i++) {
+			if (bounds_key[2 * i] != polygons[i].id || bounds_key[2 * i + 1] != polygons[i].get_revision())
+				return true;
+		}
+		return false;
+	}
+
+	int select_lod(int current, double screen_size) {
+		current = std::min(std::max(current, 0), (int)lods.size() - 1);
+		while (current + 1 < lods.size() && screen_size < lods[current + 1].screen_size * (1 - lod_hysteresis))
+			current++;
+		while (current > 0 && screen_size > lods[current].screen_size * (1 + lod_hysteresis))
+			current--;
+		return current;
+	}
+
 public:
 	bool border = false, transparent = false;
 	int id = -1;
-	double border_width = 0.003;
+	double border_width = 2;
 
 	GraphObject(const GraphObject& object) {
 		free_polygon_id = object.free_polygon_id;
 		count_points = object.count_points;
 		center = object.center;
 		border_color = object.border_color;
-		models = object.models;
+		outline_id = object.outline_id;
+		instances = object.instances;
 		max_count_models = object.max_count_models;
 		polygons = object.polygons;
 		shader_program = object.shader_program;
 		border = object.border;
 		transparent = object.transparent;
+		id = object.id;
 		border_width = object.border_width;
+		radius = object.radius;
+		lod_hysteresis = object.lod_hysteresis;
+		lods = object.lods;
 
 		create_matrix_buffer();
-		set_uniforms();
 
-		glBindBuffer(GL_ARRAY_BUFFER, matrix_buffer);
+		gl_state.bind_buffer(GL_COPY_READ_BUFFER, object.matrix_buffer);
+		gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, matrix_buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(float) * INSTANCE_SIZE * max_count_models);
 
-		glBindBuffer(GL_COPY_READ_BUFFER, object.matrix_buffer);
-		glBindBuffer(GL_COPY_WRITE_BUFFER, matrix_buffer);
-		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(float) * 16 * max_count_models);
-		glBindBuffer(GL_COPY_READ_BUFFER, 0);
-		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		for (LodLevel& level : lods) {
+			create_lod_buffer(level);
+			level.count_instances = 0;
+		}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (object.culling)
+			enable_culling();
 	}
 
 	GraphObject(int max_count_models = 0, Shader* shader = nullptr) {
@@ -120,7 +258,41 @@ public:
 		this->max_count_models = max_count_models;
 
 		create_matrix_buffer();
-		set_uniforms();
+
+		instances.reserve(max_count_models);
+		if (max_count_models > 0)
+			add_instance(one_matrix(4).get_mat4());
+	}
+
+	void swap(GraphObject& object) {
+		std::swap(free_polygon_id, object.free_polygon_id);
+		std::swap(count_points, object.count_points);
+		std::swap(center, object.center);
+		std::swap(border_color, object.border_color);
+		std::swap(outline_id, object.outline_id);
+		std::swap(instances, object.instances);
+		std::swap(radius, object.radius);
+		std::swap(lod_hysteresis, object.lod_hysteresis);
+		std::swap(lods, object.lods);
+		std::swap(lod_revision, object.lod_revision);
+		std::swap(bounds_min, object.bounds_min);
+		std::swap(bounds_max, object.bounds_max);
+		std::swap(bounds_key, object.bounds_key);
+		std::swap(culling, object.culling);
+		std::swap(visibility_dirty, object.visibility_dirty);
+		std::swap(streamed_instances, object.streamed_instances);
+		std::swap(count_visible, object.count_visible);
+		std::swap(instance_revision, object.instance_revision);
+		std::swap(visible_buffer, object.visible_buffer);
+		std::swap(visible_instances, object.visible_instances);
+		std::swap(max_count_models, object.max_count_models);
+		std::swap(matrix_buffer, object.matrix_buffer);
+		std::swap(polygons, object.polygons);
+		std::swap(shader_program, object.shader_program);
+		std::swap(border, object.border);
+		std::swap(transparent, object.transparent);
+		std::swap(id, object.id);
+		std::swap(border_width, object.border_width);
 	}
 
 	Polygon& operator[](int id) {
@@ -134,23 +306,87 @@ public:
 
 	void set_shader(Shader* shader) {
 		shader_program = shader;
-		set_uniforms();
 
 		for (Polygon& polygon : polygons)
 			polygon.set_shader(shader);
 	}
 
+	Shader* get_shader() {
+		return shader_program;
+	}
+
 	void set_center() {
 		center = Vect3(0, 0, 0);
-		for (Polygon polygon : polygons)
+		for (Polygon& polygon : polygons)
 			center += polygon.get_center() * polygon.get_count_points();
 		center /= count_points;
+		instances.update_centers(center.get_vec3());
+		bounds_key.clear();
+	}
+
+	void set_center(Vect3 center) {
+		this->center = center;
+		instances.update_centers(center.get_vec3());
+		bounds_key.clear();
+	}
+
+	Vect3 get_center() {
+		return center;
+	}
+
+	void set_border_color(Vect3 border_color) {
+		this->border_color = border_color;
+	}
+
+	Vect3 get_border_color() {
+		return border_color;
+	}
+
+	void set_outline_id(int outline_id) {
+		this->outline_id = outline_id;
+	}
+
+	int get_outline_id() {
+		return border ? outline_id : 0;
+	}
+
+	void release_vertex_arrays() {
+		for (Polygon& polygon : polygons)
+			polygon.release_vertex_array();
+		for (LodLevel& level : lods) {
+			for (Polygon& polygon : level.polygons)
+				polygon.release_vertex_array();
+		}
+	}
+
+	void recreate_vertex_arrays() {
+		for (Polygon& polygon : polygons)
+			polygon.recreate_vertex_array();
+		for (LodLevel& level : lods) {
+			for (Polygon& polygon : level.polygons)
+				polygon.recreate_vertex_array();
+		}
+	}
+
+	void set_vertex_format(int vertex_format) {
+		for (Polygon& polygon : polygons)
+			polygon.set_vertex_format(vertex_format);
+		for (LodLevel& level : lods) {
+			for (Polygon& polygon : level.polygons)
+				polygon.set_vertex_format(vertex_format);
+		}
+	}
+
+	void flush() {
+		flush_instances();
+		for (Polygon& polygon : polygons)
+			polygon.flush();
 	}
 
 	std::vector < std::pair < Vect3, int > > get_objects() {
 		std::vector < std::pair < Vect3, int > > objects;
-		for (int i = 0; i < models.size(); i++)
-			objects.push_back({ models[i] * center, i });
+		for (int i = 0; i < instances.size(); i++)
+			objects.push_back({ Vect3(instances.centers.get(i)), i });
 		return objects;
 	}
 
@@ -160,7 +396,7 @@ public:
 		polygons.push_back(polygon);
 		polygons.back().set_shader(shader_program);
 		polygons.back().id = free_polygon_id++;
-		polygons.back().set_matrix_buffer(matrix_buffer);
+		polygons.back().set_matrix_buffer(culling ? visible_buffer : matrix_buffer);
 
 		return polygons.back().id;
 	}
@@ -169,46 +405,317 @@ public:
 		return add_polygon(Polygon(size));
 	}
 
+	void reserve_polygons(int count) {
+		polygons.reserve(polygons.size() + count);
+	}
+
+	Polygon& emplace_polygon(int size) {
+		count_points += size;
+
+		polygons.emplace_back(size, shader_program);
+		polygons.back().id = free_polygon_id++;
+		polygons.back().set_matrix_buffer(culling ? visible_buffer : matrix_buffer);
+		return polygons.back();
+	}
+
 	int add_matrix(Matrix new_matrix = one_matrix(4)) {
-		if (models.size() == max_count_models) {
+		if (instances.size() == max_count_models) {
 			std::cout << "ERROR::GRAPH_OBJECT::ADD_MATRYX\nToo many instances created.\n";
 			return -1;
 		}
 
-		models.push_back(new_matrix);
-		return models.size() - 1;
+		return add_instance(new_matrix.get_mat4());
 	}
 
 	void change_matrix(Matrix trans, int id = 0) {
 		if (max_count_models == 0)
 			return;
 
-		int sz = models.size();
+		int sz = instances.size();
+		id = (id % sz + sz) % sz;
+
+		set_instance(id, (trans * Matrix(instances.transforms[id])).get_mat4());
+	}
+
+	void set_matrix(Matrix matrix, int id = 0) {
+		if (max_count_models == 0)
+			return;
+
+		int sz = instances.size();
 		id = (id % sz + sz) % sz;
 
-		models[id] = trans * models[id];
+		set_instance(id, matrix.get_mat4());
+	}
+
+	int add_lod(double triangle_ratio, double screen_size, double max_error = 0.05, MeshSimplifier simplifier = MeshSimplifier()) {
+		if (polygons.empty() || max_count_models == 0)
+			return -1;
+
+		if (lods.empty()) {
+			set_radius();
+			lods.push_back(LodLevel());
+			lods[0].polygons = polygons;
+			create_lod_buffer(lods[0]);
+		}
+
+		if (screen_size >= lods.back().screen_size) {
+			std::cout << "ERROR::GRAPH_OBJECT::ADD_LOD\nScreen sizes of levels must decrease.\n";
+			return -1;
+		}
+
+		std::vector < Polygon >& source = lods.back().polygons;
+		std::vector < bool > used(source.size(), false);
+		std::vector < LodMesh > meshes;
+		std::vector < int > surfaces;
+		for (int i = 0; i < source.size(); i++) {
+			if (used[i])
+				continue;
+
+			LodMesh mesh;
+			int count_triangles = 0;
+			for (int j = i; j < source.size(); j++) {
+				if (used[j] || !same_surface(source[i], source[j]))
+					continue;
+
+				used[j] = true;
+				mesh.append(source[j].get_positions(), source[j].get_normals(), source[j].get_tex_coords(), source[j].get_indices());
+			}
+
+			for (Polygon& polygon : polygons) {
+				if (same_surface(source[i], polygon))
+					count_triangles += polygon.get_count_triangles();
+			}
+
+			mesh = simplifier.simplify(mesh, std::max((int)round(triangle_ratio * count_triangles), 1), max_error * max_error * radius * radius);
+			if (mesh.get_count_triangles() == 0)
+				continue;
+
+			meshes.push_back(mesh);
+			surfaces.push_back(i);
+		}
+
+		LodLevel level;
+		level.screen_size = screen_size;
+		level.polygons.reserve(meshes.size());
+		for (int i = 0; i < meshes.size(); i++) {
+			level.polygons.push_back(Polygon(meshes[i].get_count_vertices(), shader_program));
+
+			Polygon& polygon = level.polygons.back();
+			polygon.set_positions(meshes[i].positions, false);
+			polygon.set_normals(meshes[i].normals);
+			polygon.set_tex_coords(meshes[i].tex_coords);
+			polygon.set_indices(meshes[i].indices);
+			polygon.material = source[surfaces[i]].material;
+			polygon.diffuse_map = source[surfaces[i]].diffuse_map;
+			polygon.specular_map = source[surfaces[i]].specular_map;
+			polygon.emission_map = source[surfaces[i]].emission_map;
+			polygon.set_vertex_format(source[surfaces[i]].get_vertex_format());
+		}
+
+		lods.push_back(level);
+		create_lod_buffer(lods.back());
+		return lods.size() - 1;
+	}
+
+	void clear_lods() {
+		for (LodLevel& level : lods)
+			gl_state.delete_buffer(level.matrix_buffer);
+		lods.clear();
+		std::fill(instances.lods.begin(), instances.lods.end(), 0);
+	}
+
+	void set_lod_hysteresis(double lod_hysteresis) {
+		this->lod_hysteresis = std::max(lod_hysteresis, 0.0);
+	}
+
+	int get_count_lods() {
+		return lods.size();
+	}
 
-		glBindBuffer(GL_ARRAY_BUFFER, matrix_buffer);
-		glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 16 * id, sizeof(float) * 16, models[id].value_ptr());
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	int get_lod(int id) {
+		if (id < 0 || id >= instances.size())
+			return 0;
+		return instances.lods[id];
 	}
 
-	void draw(Vect3 view_pos = Vect3(0, 0, 0), int id = -1) {
+	void update_lods(Vect3 view_pos, double lod_scale) {
+		if (lods.empty())
+			return;
+
+		int count = instances.size();
+		lod_distances.resize(count);
+		get_distances_sqr(instances.centers.span(), view_pos.get_vec3(), lod_distances.data());
+
+		bool changed = lod_revision != instance_revision;
+		for (int i = 0; i < count; i++) {
+			if (!is_visible(i))
+				continue;
+
+			double screen_size = radius * sqrt(instances.scales[i]) * lod_scale / std::max(sqrt(lod_distances[i]), 0.000001f);
+			int lod = select_lod(instances.lods[i], screen_size);
+			changed |= lod != instances.lods[i];
+			instances.lods[i] = lod;
+		}
+		if (!changed)
+			return;
+		lod_revision = instance_revision;
+
+		for (LodLevel& level : lods) {
+			level.count_instances = 0;
+			level.instances.resize(INSTANCE_SIZE * count);
+		}
+
+		for (int i = 0; i < count; i++) {
+			if (!is_visible(i))
+				continue;
+
+			LodLevel& level = lods[instances.lods[i]];
+			std::copy(instances.get_row(i), instances.get_row(i + 1), level.instances.begin() + INSTANCE_SIZE * level.count_instances);
+			level.count_instances++;
+		}
+
+		for (LodLevel& level : lods) {
+			if (level.count_instances == 0)
+				continue;
+
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, level.matrix_buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * INSTANCE_SIZE * level.count_instances, level.instances.data());
+			frame_counters.buffer_uploads++;
+		}
+	}
+
+	void get_bounding_box(vec3& min_point, vec3& max_point) {
+		if (is_bounds_dirty()) {
+			bounds_min = { INFINITY, INFINITY, INFINITY };
+			bounds_max = { -INFINITY, -INFINITY, -INFINITY };
+			bounds_key.clear();
+			for (Polygon& polygon : polygons) {
+				vec3 polygon_min, polygon_max;
+				polygon.get_bounding_box(polygon_min, polygon_max);
+				bounds_min = { std::min(bounds_min.x, polygon_min.x), std::min(bounds_min.y, polygon_min.y), std::min(bounds_min.z, polygon_min.z) };
+				bounds_max = { std::max(bounds_max.x, polygon_max.x), std::max(bounds_max.y, polygon_max.y), std::max(bounds_max.z, polygon_max.z) };
+				bounds_key.push_back(polygon.id);
+				bounds_key.push_back(polygon.get_revision());
+			}
+		}
+
+		min_point = bounds_min;
+		max_point = bounds_max;
+	}
+
+	std::vector < Polygon >& get_polygons() {
+		return polygons;
+	}
+
+	std::vector < float > get_instances() {
+		std::vector < float > rows;
+		for (int i = 0; i < instances.size(); i++) {
+			if (is_visible(i))
+				rows.insert(rows.end(), instances.get_row(i), instances.get_row(i + 1));
+		}
+		return rows;
+	}
+
+	const std::vector < float >& get_instance_rows() {
+		return instances.rows;
+	}
+
+	void load_instances(const float* rows, int count) {
+		if (count > max_count_models) {
+			std::cout << "ERROR::GRAPH_OBJECT::LOAD_INSTANCES\nToo many instances.\n";
+			count = max_count_models;
+		}
+
+		instances.assign(rows, count, center.get_vec3());
+		visibility_dirty = true;
+		instance_revision++;
+	}
+
+	int get_instance_revision() {
+		return instance_revision;
+	}
+
+	int get_max_count_models() {
+		return max_count_models;
+	}
+
+	bool can_draw_indirect() {
+		return shader_program != nullptr && !transparent && lods.empty() && instances.size() > 0;
+	}
+
+	bool is_visible(int id) {
+		return !culling || id < 0 || id >= instances.size() || !instances.is_culled(id);
+	}
+
+	void update_visibility(OcclusionCuller* culler) {
+		if (culler == nullptr || !culler->is_ready() || instances.size() == 0 || polygons.empty()) {
+			clear_visibility();
+			return;
+		}
+
+		vec3 min_point, max_point;
+		get_bounding_box(min_point, max_point);
+
+		bool changed = !culling;
+		for (int i = 0; i < instances.size(); i++) {
+			bool culled = !culler->is_visible(instances.get_row(i), min_point, max_point);
+			frame_counters.culled_instances += culled;
+			changed |= culled != instances.is_culled(i);
+			instances.set_culled(i, culled);
+		}
+
+		if (!culling)
+			enable_culling();
+
+		if (changed) {
+			visibility_dirty = true;
+			instance_revision++;
+		}
+	}
+
+	void draw(MaterialTable& material_table, int id = -1) {
 		if (shader_program == nullptr)
 			return;
 
-		if (border) {
-			glClear(GL_STENCIL_BUFFER_BIT);
-			glStencilFunc(GL_ALWAYS, 1, 0xFF);
+		draw_polygons(material_table, id);
+	}
+
+	void draw_instances(MaterialTable& material_table, unsigned int buffer, int first_instance, int count, int lod = 0) {
+		if (shader_program == nullptr || count == 0)
+			return;
+
+		glUniform1i(glGetUniformLocation(shader_program->program, "use_instance"), true);
+		glUniform1i(glGetUniformLocation(shader_program->program, "pick_object"), this->id);
+		glUniform1i(glGetUniformLocation(shader_program->program, "outline_id"), get_outline_id());
+		frame_counters.uniform_uploads += 3;
+
+		bool use_lod = !lods.empty() && 0 <= lod && lod < lods.size();
+		std::vector < Polygon >& run_polygons = use_lod ? lods[lod].polygons : polygons;
+		for (Polygon& polygon : run_polygons) {
+			polygon.set_matrix_buffer(buffer, first_instance);
+			polygon.set_uniforms(material_table);
+			polygon.draw(count);
 		}
+		streamed_instances = true;
+	}
 
-		draw_polygons(id);
+	void restore_matrix_buffers() {
+		if (!streamed_instances)
+			return;
 
-		if (border)
-			draw_border(view_pos, id);
+		streamed_instances = false;
+		for (Polygon& polygon : polygons)
+			polygon.set_matrix_buffer(culling ? visible_buffer : matrix_buffer);
+		for (LodLevel& level : lods) {
+			for (Polygon& polygon : level.polygons)
+				polygon.set_matrix_buffer(level.matrix_buffer);
+		}
 	}
 
 	~GraphObject() {
-		glDeleteBuffers(1, &matrix_buffer);
+		clear_lods();
+		gl_state.delete_buffer(matrix_buffer);
+		if (visible_buffer != 0)
+			gl_state.delete_buffer(visible_buffer);
 	}
 };
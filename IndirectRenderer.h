@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <GL/glew.h>
+#include "GLState.h"
+#include "GraphObject.h"
+#include "OcclusionCuller.h"
+#include "RenderStats.h"
+
+
+struct DrawCommand {
+	unsigned int count, instance_count, first_index;
+	int base_vertex;
+	unsigned int base_instance;
+};
+
+
+struct CullObject {
+	vec4 min_point, max_point;
+	unsigned int first_instance, count_instances, padding0 = 0, padding1 = 0;
+};
+
+
+struct IndirectDraw {
+	int key_id, object_id;
+	Polygon* polygon;
+	DrawCommand command;
+
+	bool operator <(const IndirectDraw& other) const {
+		return key_id < other.key_id;
+	}
+};
+
+
+class IndirectRenderer {
+	static const int DRAW_INFO_SIZE = 4, GROUP_SIZE = 64;
+	static constexpr unsigned int NO_OBJECT = 0xFFFFFFFF;
+
+	int count_vertices = 0, count_indices = 0, count_instances = 0;
+	unsigned int vertex_array = 0, vertex_buffer = 0, index_buffer = 0, instance_buffer = 0, command_buffer = 0, material_buffer = 0, material_texture = 0;
+
+	unsigned int instance_source = 0, culled_buffer = 0, object_buffer = 0, slot_buffer = 0, counter_buffer = 0, command_object_buffer = 0;
+	Shader* cull_shader = nullptr;
+	std::vector < CullObject > cull_objects;
+
+	std::vector < int > signature, object_offsets, object_revisions, object_counts;
+	std::vector < unsigned int > first_indices;
+	std::vector < int > base_vertices;
+	std::vector < float > materials;
+	std::vector < DrawCommand > commands;
+
+	std::vector < int > get_signature(std::vector < GraphObject >& objects) {
+		std::vector < int > result;
+		for (GraphObject& object : objects) {
+			if (!object.can_draw_indirect())
+				continue;
+
+			object.flush();
+			result.push_back(object.id);
+			result.push_back(object.get_max_count_models());
+			result.push_back(object.get_polygons().size());
+			for (Polygon& polygon : object.get_polygons()) {
+				result.push_back(polygon.id);
+				result.push_back(polygon.get_revision());
+				result.push_back(polygon.get_count_points());
+				result.push_back(polygon.get_count_triangles());
+			}
+		}
+		return result;
+	}
+
+	void create_buffer(unsigned int& buffer, GLenum target, long long size, const void* data, GLenum usage) {
+		if (buffer == 0)
+			glGenBuffers(1, &buffer);
+		gl_state.bind_buffer(target, buffer);
+		glBufferData(target, size, data, usage);
+		frame_counters.buffer_uploads++;
+	}
+
+	void set_attributes() {
+		instance_source = cull_shader == nullptr ? instance_buffer : culled_buffer;
+		gl_state.bind_vertex_array(vertex_array);
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(sizeof(float) * 3 * count_vertices));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)(sizeof(float) * 6 * count_vertices));
+		glEnableVertexAttribArray(2);
+		glVertexAttribIPointer(10, 1, GL_INT, sizeof(int), (void*)(sizeof(float) * 8 * count_vertices));
+		glEnableVertexAttribArray(10);
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, instance_source);
+		for (int i = 0; i < 4; i++) {
+			glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(float) * INSTANCE_SIZE, (void*)(sizeof(float) * 4 * i));
+			glEnableVertexAttribArray(3 + i);
+			glVertexAttribDivisor(3 + i, 1);
+		}
+		for (int i = 0; i < 3; i++) {
+			glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, sizeof(float) * INSTANCE_SIZE, (void*)(sizeof(float) * (16 + 3 * i)));
+			glEnableVertexAttribArray(7 + i);
+			glVertexAttribDivisor(7 + i, 1);
+		}
+
+		glVertexAttribPointer(11, 1, GL_FLOAT, GL_FALSE, sizeof(float) * INSTANCE_SIZE, (void*)(sizeof(float) * 25));
+		glEnableVertexAttribArray(11);
+		glVertexAttribDivisor(11, 1);
+
+		gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	}
+
+	void rebuild(std::vector < GraphObject >& objects) {
+		count_vertices = 0;
+		count_indices = 0;
+		count_instances = 0;
+		object_offsets.clear();
+		for (GraphObject& object : objects) {
+			if (!object.can_draw_indirect())
+				continue;
+
+			object_offsets.push_back(count_instances);
+			count_instances += object.get_max_count_models();
+			for (Polygon& polygon : object.get_polygons()) {
+				count_vertices += polygon.get_count_points();
+				count_indices += 3 * polygon.get_count_triangles();
+			}
+		}
+		object_revisions.assign(object_offsets.size(), -1);
+		object_counts.assign(object_offsets.size(), 0);
+
+		create_buffer(vertex_buffer, GL_ARRAY_BUFFER, (sizeof(float) * 8 + sizeof(int)) * std::max(count_vertices, 1), NULL, GL_STATIC_DRAW);
+		create_buffer(instance_buffer, GL_ARRAY_BUFFER, sizeof(float) * INSTANCE_SIZE * std::max(count_instances, 1), NULL, GL_DYNAMIC_DRAW);
+		create_buffer(culled_buffer, GL_ARRAY_BUFFER, sizeof(float) * INSTANCE_SIZE * std::max(count_instances, 1), NULL, GL_DYNAMIC_COPY);
+
+		std::vector < unsigned int > instance_objects(std::max(count_instances, 1), NO_OBJECT);
+		cull_objects.clear();
+		for (GraphObject& object : objects) {
+			if (!object.can_draw_indirect())
+				continue;
+
+			CullObject cull_object;
+			vec3 min_point, max_point;
+			object.get_bounding_box(min_point, max_point);
+			cull_object.min_point = { min_point.x, min_point.y, min_point.z, 1 };
+			cull_object.max_point = { max_point.x, max_point.y, max_point.z, 1 };
+			cull_object.first_instance = object_offsets[cull_objects.size()];
+			cull_object.count_instances = 0;
+			std::fill(instance_objects.begin() + cull_object.first_instance, instance_objects.begin() + cull_object.first_instance + object.get_max_count_models(), cull_objects.size());
+			cull_objects.push_back(cull_object);
+		}
+		create_buffer(slot_buffer, GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * instance_objects.size(), instance_objects.data(), GL_STATIC_DRAW);
+		create_buffer(object_buffer, GL_SHADER_STORAGE_BUFFER, sizeof(CullObject) * std::max((int)cull_objects.size(), 1), NULL, GL_DYNAMIC_DRAW);
+		create_buffer(counter_buffer, GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * std::max((int)cull_objects.size(), 1), NULL, GL_DYNAMIC_COPY);
+
+		std::vector < unsigned int > indices;
+		std::vector < int > material_ids;
+		first_indices.clear();
+		base_vertices.clear();
+		gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+		for (GraphObject& object : objects) {
+			if (!object.can_draw_indirect())
+				continue;
+
+			for (Polygon& polygon : object.get_polygons()) {
+				int count_points = polygon.get_count_points(), base_vertex = material_ids.size();
+				first_indices.push_back(indices.size());
+				base_vertices.push_back(base_vertex);
+
+				std::vector < unsigned int > polygon_indices = polygon.get_indices();
+				indices.insert(indices.end(), polygon_indices.begin(), polygon_indices.begin() + 3 * polygon.get_count_triangles());
+				material_ids.resize(base_vertex + count_points, base_vertices.size() - 1);
+
+				if (count_points == 0)
+					continue;
+
+				if (polygon.get_vertex_format() == VERTEX_FORMAT_PACKED) {
+					std::vector < float > vertices = polygon.get_vertices();
+					gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+					glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(float) * 3 * base_vertex, sizeof(float) * 3 * count_points, vertices.data());
+					glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(float) * 3 * (count_vertices + base_vertex), sizeof(float) * 3 * count_points, vertices.data() + 3 * count_points);
+					glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(float) * (6 * count_vertices + 2 * base_vertex), sizeof(float) * 2 * count_points, vertices.data() + 6 * count_points);
+					frame_counters.buffer_uploads += 3;
+					continue;
+				}
+
+				gl_state.bind_buffer(GL_COPY_READ_BUFFER, polygon.get_vertex_buffer());
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, sizeof(float) * 3 * base_vertex, sizeof(float) * 3 * count_points);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sizeof(float) * 3 * count_points, sizeof(float) * 3 * (count_vertices + base_vertex), sizeof(float) * 3 * count_points);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sizeof(float) * 6 * count_points, sizeof(float) * (6 * count_vertices + 2 * base_vertex), sizeof(float) * 2 * count_points);
+			}
+		}
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 8 * count_vertices, sizeof(int) * material_ids.size(), material_ids.data());
+		frame_counters.buffer_uploads++;
+
+		gl_state.bind_vertex_array(vertex_array);
+		create_buffer(index_buffer, GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * std::max(count_indices, 1), indices.data(), GL_STATIC_DRAW);
+		set_attributes();
+
+		materials.clear();
+		create_buffer(material_buffer, GL_TEXTURE_BUFFER, sizeof(float) * DRAW_INFO_SIZE * std::max((int)first_indices.size(), 1), NULL, GL_DYNAMIC_DRAW);
+		gl_state.bind_texture(GL_TEXTURE_BUFFER, material_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, material_buffer);
+	}
+
+	void cull_instances(const mat4& view_projection, DepthPyramid pyramid, std::vector < unsigned int >& command_objects) {
+		create_buffer(command_object_buffer, GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * command_objects.size(), command_objects.data(), GL_STREAM_DRAW);
+
+		gl_state.bind_buffer(GL_SHADER_STORAGE_BUFFER, counter_buffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+		gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, instance_buffer);
+		gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 1, culled_buffer);
+		gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 2, object_buffer);
+		gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 3, slot_buffer);
+		gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 4, counter_buffer);
+		gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 5, command_buffer);
+		gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 6, command_object_buffer);
+
+		cull_shader->use();
+		unsigned int program = cull_shader->program;
+		glUniformMatrix4fv(glGetUniformLocation(program, "view_projection"), 1, GL_FALSE, view_projection.m);
+		glUniform1i(glGetUniformLocation(program, "use_pyramid"), pyramid.texture != 0);
+		frame_counters.uniform_uploads += 2;
+		if (pyramid.texture != 0) {
+			gl_state.bind_texture_unit(4, GL_TEXTURE_2D, pyramid.texture);
+			glUniform2i(glGetUniformLocation(program, "pyramid_size"), pyramid.width, pyramid.height);
+			glUniform2i(glGetUniformLocation(program, "depth_size"), pyramid.base_width, pyramid.base_height);
+			glUniform1i(glGetUniformLocation(program, "pyramid_shift"), pyramid.shift);
+			glUniformMatrix4fv(glGetUniformLocation(program, "pyramid_view_projection"), 1, GL_FALSE, pyramid.view_projection.m);
+			frame_counters.uniform_uploads += 4;
+		}
+
+		glUniform1i(glGetUniformLocation(program, "stage"), 0);
+		glUniform1ui(glGetUniformLocation(program, "count_items"), count_instances);
+		glDispatchCompute((count_instances + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		glUniform1i(glGetUniformLocation(program, "stage"), 1);
+		glUniform1ui(glGetUniformLocation(program, "count_items"), command_objects.size());
+		glDispatchCompute((command_objects.size() + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		frame_counters.uniform_uploads += 4;
+	}
+
+	void write_draw_info(Polygon& polygon, MaterialTable& material_table, int object_id, int outline_id, float* result) {
+		float values[DRAW_INFO_SIZE] = { (float)polygon.get_material_index(material_table), (float)object_id, (float)polygon.id, (float)outline_id };
+		std::copy(values, values + DRAW_INFO_SIZE, result);
+	}
+
+	int get_key_id(std::vector < std::vector < unsigned int > >& keys, Polygon& polygon) {
+		std::vector < unsigned int > key = { polygon.diffuse_map.texture_id, polygon.specular_map.texture_id, polygon.emission_map.texture_id };
+		for (int i = 0; i < keys.size(); i++) {
+			if (keys[i] == key)
+				return i;
+		}
+		keys.push_back(key);
+		return keys.size() - 1;
+	}
+
+public:
+	static bool is_supported() {
+		return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+	}
+
+	static bool is_compute_supported() {
+		return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_clear_buffer_object);
+	}
+
+	void set_cull_shader(Shader* cull_shader) {
+		this->cull_shader = cull_shader;
+		if (cull_shader != nullptr) {
+			cull_shader->use();
+			glUniform1i(glGetUniformLocation(cull_shader->program, "pyramid_map"), 4);
+			glUniform1i(glGetUniformLocation(cull_shader->program, "instance_size"), INSTANCE_SIZE);
+		}
+		if (vertex_array != 0 && vertex_buffer != 0)
+			set_attributes();
+	}
+
+	void create() {
+		glGenVertexArrays(1, &vertex_array);
+		glGenTextures(1, &material_texture);
+		signature.clear();
+	}
+
+	void draw(std::vector < GraphObject >& objects, Shader* shader_program, MaterialTable& material_table, const mat4& view_projection, DepthPyramid pyramid = DepthPyramid()) {
+		if (vertex_array == 0)
+			return;
+
+		std::vector < int > new_signature = get_signature(objects);
+		if (new_signature.empty())
+			return;
+		if (new_signature != signature) {
+			signature = new_signature;
+			rebuild(objects);
+		}
+
+		std::vector < float > new_materials(DRAW_INFO_SIZE * first_indices.size());
+		std::vector < std::vector < unsigned int > > keys;
+		std::vector < IndirectDraw > draws;
+		bool objects_changed = false;
+		int object_id = 0, polygon_id = 0;
+		for (GraphObject& object : objects) {
+			if (!object.can_draw_indirect())
+				continue;
+
+			if (object.get_instance_revision() != object_revisions[object_id]) {
+				std::vector < float > instances = object.get_instances();
+				object_revisions[object_id] = object.get_instance_revision();
+				object_counts[object_id] = instances.size() / INSTANCE_SIZE;
+				cull_objects[object_id].count_instances = object_counts[object_id];
+				objects_changed = true;
+
+				gl_state.bind_buffer(GL_ARRAY_BUFFER, instance_buffer);
+				glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * INSTANCE_SIZE * object_offsets[object_id], sizeof(float) * instances.size(), instances.data());
+				frame_counters.buffer_uploads++;
+			}
+
+			for (Polygon& polygon : object.get_polygons()) {
+				write_draw_info(polygon, material_table, object.id, object.get_outline_id(), new_materials.data() + DRAW_INFO_SIZE * polygon_id);
+
+				DrawCommand command = { (unsigned int)(3 * polygon.get_count_triangles()), (unsigned int)object_counts[object_id], first_indices[polygon_id], base_vertices[polygon_id], (unsigned int)object_offsets[object_id] };
+				if (command.count > 0 && command.instance_count > 0)
+					draws.push_back({ get_key_id(keys, polygon), object_id, &polygon, command });
+				polygon_id++;
+			}
+			object_id++;
+		}
+
+		if (new_materials != materials) {
+			materials = new_materials;
+			gl_state.bind_buffer(GL_TEXTURE_BUFFER, material_buffer);
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * materials.size(), materials.data());
+			frame_counters.buffer_uploads++;
+		}
+
+		if (objects_changed) {
+			gl_state.bind_buffer(GL_SHADER_STORAGE_BUFFER, object_buffer);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CullObject) * cull_objects.size(), cull_objects.data());
+			frame_counters.buffer_uploads++;
+		}
+
+		if (draws.empty())
+			return;
+
+		std::stable_sort(draws.begin(), draws.end());
+		commands.resize(draws.size());
+		std::vector < unsigned int > command_objects(draws.size());
+		for (int i = 0; i < draws.size(); i++) {
+			commands[i] = draws[i].command;
+			command_objects[i] = draws[i].object_id;
+		}
+		create_buffer(command_buffer, GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * commands.size(), commands.data(), GL_STREAM_DRAW);
+
+		if (cull_shader != nullptr) {
+			if (instance_source != culled_buffer)
+				set_attributes();
+			cull_instances(view_projection, pyramid, command_objects);
+		}
+
+		shader_program->use();
+		glUniform1i(glGetUniformLocation(shader_program->program, "use_instance"), 1);
+		glUniform1i(glGetUniformLocation(shader_program->program, "use_indirect"), 1);
+		frame_counters.uniform_uploads += 2;
+
+		gl_state.bind_texture_unit(3, GL_TEXTURE_BUFFER, material_texture);
+		gl_state.bind_vertex_array(vertex_array);
+		for (int begin = 0, end = 0; begin < draws.size(); begin = end) {
+			while (end < draws.size() && draws[end].key_id == draws[begin].key_id)
+				end++;
+
+			draws[begin].polygon->set_textures();
+			gl_state.bind_vertex_array(vertex_array);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(sizeof(DrawCommand) * begin), end - begin, 0);
+			frame_counters.draw_calls++;
+
+			for (int i = begin; i < end && cull_shader == nullptr; i++) {
+				frame_counters.instances += draws[i].command.instance_count;
+				frame_counters.triangles += (long long)(draws[i].command.count / 3) * draws[i].command.instance_count;
+			}
+		}
+
+		glUniform1i(glGetUniformLocation(shader_program->program, "use_indirect"), 0);
+		frame_counters.uniform_uploads++;
+	}
+
+	void destroy() {
+		if (vertex_array == 0)
+			return;
+
+		gl_state.delete_vertex_array(vertex_array);
+		gl_state.delete_texture(material_texture);
+		for (unsigned int buffer : { vertex_buffer, index_buffer, instance_buffer, command_buffer, material_buffer, culled_buffer, object_buffer, slot_buffer, counter_buffer, command_object_buffer }) {
+			if (buffer != 0)
+				gl_state.delete_buffer(buffer);
+		}
+		vertex_array = vertex_buffer = index_buffer = instance_buffer = command_buffer = material_buffer = material_texture = 0;
+		culled_buffer = object_buffer = slot_buffer = counter_buffer = command_object_buffer = instance_source = 0;
+		signature.clear();
+		materials.clear();
+	}
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "CommonClasses/VectorMath.h"
+
+
+const int INSTANCE_SIZE = 26;
+const unsigned char INSTANCE_CULLED = 1;
+
+
+class InstanceStorage {
+	int count = 0;
+	bool any_dirty = false;
+	std::vector < uint64_t > dirty_bits;
+
+public:
+	std::vector < mat4 > transforms;
+	std::vector < float > rows, scales;
+	std::vector < unsigned char > flags;
+	std::vector < int > lods;
+	PointArray centers;
+
+	void update_bounds(int id, vec3 local_center) {
+		const float* m = transforms[id].m;
+		centers.set(id, transforms[id].transform_point(local_center));
+		scales[id] = 0;
+		for (int j = 0; j < 3; j++)
+			scales[id] = std::max(scales[id], m[4 * j] * m[4 * j] + m[4 * j + 1] * m[4 * j + 1] + m[4 * j + 2] * m[4 * j + 2]);
+	}
+
+	void reserve(int capacity) {
+		transforms.reserve(capacity);
+		rows.reserve(INSTANCE_SIZE * capacity);
+		scales.reserve(capacity);
+		flags.reserve(capacity);
+		lods.reserve(capacity);
+		centers.x.reserve(capacity);
+		centers.y.reserve(capacity);
+		centers.z.reserve(capacity);
+		dirty_bits.reserve((capacity + 63) / 64);
+	}
+
+	int size() const {
+		return count;
+	}
+
+	int add(const mat4& transform, vec3 local_center) {
+		count++;
+		transforms.resize(count);
+		rows.resize(INSTANCE_SIZE * count);
+		scales.resize(count);
+		flags.resize(count, 0);
+		lods.resize(count, 0);
+		centers.resize(count);
+		dirty_bits.resize((count + 63) / 64, 0);
+
+		set(count - 1, transform, local_center);
+		return count - 1;
+	}
+
+	void set(int id, const mat4& transform, vec3 local_center) {
+		float* row = rows.data() + INSTANCE_SIZE * id;
+		transforms[id] = transform;
+		std::copy(transform.m, transform.m + 16, row);
+		transform.get_normal_matrix(row + 16);
+		row[25] = id;
+		update_bounds(id, local_center);
+
+		dirty_bits[id >> 6] |= (uint64_t)1 << (id & 63);
+		any_dirty = true;
+	}
+
+	void assign(const float* source, int count, vec3 local_center) {
+		this->count = count;
+		transforms.resize(count);
+		rows.assign(source, source + INSTANCE_SIZE * count);
+		scales.resize(count);
+		flags.assign(count, 0);
+		lods.assign(count, 0);
+		centers.resize(count);
+		dirty_bits.assign((count + 63) / 64, 0);
+
+		for (int i = 0; i < count; i++) {
+			std::copy(source + INSTANCE_SIZE * i, source + INSTANCE_SIZE * i + 16, transforms[i].m);
+			rows[INSTANCE_SIZE * i + 25] = i;
+			update_bounds(i, local_center);
+		}
+		mark_all_dirty();
+	}
+
+	void update_centers(vec3 local_center) {
+		for (int i = 0; i < count; i++)
+			centers.set(i, transforms[i].transform_point(local_center));
+	}
+
+	bool is_culled(int id) const {
+		return flags[id] & INSTANCE_CULLED;
+	}
+
+	void set_culled(int id, bool culled) {
+		flags[id] = culled ? flags[id] | INSTANCE_CULLED : flags[id] & ~INSTANCE_CULLED;
+	}
+
+	const float* get_row(int id) const {
+		return rows.data() + INSTANCE_SIZE * id;
+	}
+
+	bool has_dirty() const {
+		return any_dirty;
+	}
+
+	void mark_all_dirty() {
+		for (int i = 0; i < count; i++)
+			dirty_bits[i >> 6] |= (uint64_t)1 << (i & 63);
+		any_dirty = count > 0;
+	}
+
+	template < typename Func >
+	void take_dirty_ranges(Func func) {
+		if (!any_dirty)
+			return;
+
+		int begin = -1;
+		for (int word = 0; word < dirty_bits.size(); word++) {
+			uint64_t bits = dirty_bits[word];
+			dirty_bits[word] = 0;
+			if ((begin == -1 && bits == 0) || (begin != -1 && bits == ~(uint64_t)0))
+				continue;
+
+			for (int i = 0; i < 64; i++) {
+				if (((bits >> i) & 1) == (begin != -1))
+					continue;
+
+				if (begin == -1) {
+					begin = 64 * word + i;
+				}
+				else {
+					func(begin, 64 * word + i);
+					begin = -1;
+				}
+			}
+		}
+		if (begin != -1)
+			func(begin, count);
+		any_dirty = false;
+	}
+};
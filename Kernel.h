@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include "Shader.h"
+#include "RenderStats.h"
 #include "CommonClasses/Matrix.h"
 
 
@@ -30,5 +31,6 @@ public:
 
 	void use(Shader* shader) {
 		glUniform1fv(glGetUniformLocation(shader->program, "kernel"), 9, kernel.value_ptr());
+		frame_counters.uniform_uploads++;
 	}
 };
@@ -12,15 +12,25 @@ protected:
 
 public:
 	Vect3 ambient = Vect3(0, 0, 0), diffuse = Vect3(0, 0, 0), specular = Vect3(0, 0, 0);
+    Vect3 proxy_color = Vect3(1, 1, 1);
     int id = -1;
 
     Light() {
         shader_program = nullptr;
     }
 
-    virtual void draw(int draw_id) = 0;
+    virtual ~Light() {
+    }
+
+    virtual void draw(MaterialTable& material_table, int draw_id) = 0;
+
+    virtual bool get_proxy(mat4&) {
+        return false;
+    }
 
     virtual void set_shader(Shader* shader) = 0;
+
+    virtual Light* clone() = 0;
 };
 
 
@@ -33,7 +43,7 @@ public:
         this->dir = dir;
     }
 
-    void draw(int draw_id) {
+    void draw(MaterialTable& material_table, int draw_id) {
         if (shader_program == nullptr)
             return;
 
@@ -43,11 +53,16 @@ public:
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "ambient").c_str()), ambient.x, ambient.y, ambient.z);
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "diffuse").c_str()), diffuse.x, diffuse.y, diffuse.z);
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "specular").c_str()), specular.x, specular.y, specular.z);
+        frame_counters.uniform_uploads += 5;
     }
 
     void set_shader(Shader* shader) {
         shader_program = shader;
     }
+
+    Light* clone() {
+        return new DirLight(*this);
+    }
 };
 
 
@@ -57,32 +72,6 @@ class PointLight : public Light {
     Vect3 pos;
     GraphObject obj;
 
-    void set_default_object() {
-        obj = GraphObject(1, shader_program);
-        int pol = obj.add_polygon(4);
-        obj[pol].set_positions({
-             0.5,  0.5, 0.5,
-             0.5, -0.5, 0.5,
-            -0.5, -0.5, 0.5,
-            -0.5,  0.5, 0.5
-        });
-        obj[pol].material.emission = Vect3(1, 1, 1);
-        obj[pol].material.light = true;
-
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 1, 0), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 1, 0), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 1, 0), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 0, 1), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 0, 1), PI));
-        obj.change_matrix(scale_matrix(1.0 / 5));
-        obj.change_matrix(trans_matrix(pos));
-    }
-
 public:
     double constant = 1, linear = 0, quadratic = 0;
 
@@ -91,11 +80,12 @@ public:
         this->pos = pos;
     }
 
-    void draw(int draw_id) {
+    void draw(MaterialTable& material_table, int draw_id) {
         if (shader_program == nullptr)
             return;
 
-        obj.draw();
+        if (!default_obj)
+            obj.draw(material_table);
 
         std::string name = "lights[" + std::to_string(draw_id) + "].";
         glUniform1i(glGetUniformLocation(shader_program->program, (name + "type").c_str()), 1);
@@ -106,19 +96,31 @@ public:
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "ambient").c_str()), ambient.x, ambient.y, ambient.z);
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "diffuse").c_str()), diffuse.x, diffuse.y, diffuse.z);
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "specular").c_str()), specular.x, specular.y, specular.z);
+        frame_counters.uniform_uploads += 8;
     }
 
     void set_position(Vect3 new_pos) {
-        obj.change_matrix(trans_matrix(new_pos - pos));
+        if (!default_obj)
+            obj.change_matrix(trans_matrix(new_pos - pos));
         pos = new_pos;
     }
 
+    Vect3 get_position() {
+        return pos;
+    }
+
+    bool get_proxy(mat4& model) {
+        if (!default_obj)
+            return false;
+
+        model = (trans_matrix(pos) * scale_matrix(1.0 / 5)).get_mat4();
+        return true;
+    }
+
     void set_shader(Shader* shader) {
         shader_program = shader;
 
-        if (default_obj)
-            set_default_object();
-        else
+        if (!default_obj)
             obj.set_shader(shader_program);
     }
 
@@ -129,9 +131,13 @@ public:
     }
 
     void delete_object() {
-        set_default_object();
+        obj = GraphObject();
         default_obj = true;
     }
+
+    Light* clone() {
+        return new PointLight(*this);
+    }
 };
 
 
@@ -141,33 +147,6 @@ class SpotLight : public Light {
     Vect3 pos;
     GraphObject obj;
 
-    void set_default_object() {
-        obj = GraphObject(1, shader_program);
-        int pol = obj.add_polygon(4);
-        obj[pol].set_positions({
-             0.5,  0.5, 0.5,
-             0.5, -0.5, 0.5,
-            -0.5, -0.5, 0.5,
-            -0.5,  0.5, 0.5
-        });
-        obj[pol].material.emission = Vect3(1, 1, 1);
-        obj[pol].material.light = true;
-
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 1, 0), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 1, 0), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 1, 0), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 0, 1), PI / 2));
-        pol = obj.add_polygon(obj[pol]);
-        obj[pol].change_matrix(rotate_matrix(Vect3(0, 0, 1), PI));
-        obj.change_matrix(rotate_matrix(Vect3(0, 0, 1), PI / 4));
-        obj.change_matrix(scale_matrix(1.0 / 5));
-        obj.change_matrix(trans_matrix(pos));
-    }
-
 public:
     double constant = 1, linear = 0, quadratic = 0;
 
@@ -182,11 +161,12 @@ public:
         this->cut_out = cut_out;
     }
 
-    void draw(int draw_id) {
+    void draw(MaterialTable& material_table, int draw_id) {
         if (shader_program == nullptr)
             return;
 
-        obj.draw();
+        if (!default_obj)
+            obj.draw(material_table);
 
         std::string name = "lights[" + std::to_string(draw_id) + "].";
         glUniform1i(glGetUniformLocation(shader_program->program, (name + "type").c_str()), 2);
@@ -200,19 +180,31 @@ public:
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "ambient").c_str()), ambient.x, ambient.y, ambient.z);
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "diffuse").c_str()), diffuse.x, diffuse.y, diffuse.z);
         glUniform3f(glGetUniformLocation(shader_program->program, (name + "specular").c_str()), specular.x, specular.y, specular.z);
+        frame_counters.uniform_uploads += 11;
     }
 
     void set_position(Vect3 new_pos) {
-        obj.change_matrix(trans_matrix(new_pos - pos));
+        if (!default_obj)
+            obj.change_matrix(trans_matrix(new_pos - pos));
         pos = new_pos;
     }
 
+    Vect3 get_position() {
+        return pos;
+    }
+
+    bool get_proxy(mat4& model) {
+        if (!default_obj)
+            return false;
+
+        model = (trans_matrix(pos) * scale_matrix(1.0 / 5) * rotate_matrix(Vect3(0, 0, 1), PI / 4)).get_mat4();
+        return true;
+    }
+
     void set_shader(Shader* shader) {
         shader_program = shader;
 
-        if (default_obj)
-            set_default_object();
-        else
+        if (!default_obj)
             obj.set_shader(shader_program);
     }
 
@@ -223,9 +215,13 @@ public:
     }
 
     void delete_object() {
-        set_default_object();
+        obj = GraphObject();
         default_obj = true;
     }
+
+    Light* clone() {
+        return new SpotLight(*this);
+    }
 };
 
 
@@ -236,4 +232,5 @@ void draw_default_light(int draw_id, Shader* shader_program) {
     glUniform3f(glGetUniformLocation(shader_program->program, (name + "ambient").c_str()), 0, 0, 0);
     glUniform3f(glGetUniformLocation(shader_program->program, (name + "diffuse").c_str()), 0, 0, 0);
     glUniform3f(glGetUniformLocation(shader_program->program, (name + "specular").c_str()), 0, 0, 0);
+    frame_counters.uniform_uploads += 5;
 }
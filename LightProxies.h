@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include "GLState.h"
+#include "Shader.h"
+#include "RenderStats.h"
+#include "CommonClasses/VectorMath.h"
+#include "CommonClasses/Vect3.h"
+
+
+class LightProxies {
+	static const int PROXY_SIZE = 19;
+
+	int capacity = 0;
+	unsigned int vertex_array = 0, vertex_buffer = 0, proxy_buffer = 0;
+	std::vector < float > proxies;
+
+	void create() {
+		if (vertex_array != 0)
+			return;
+
+		std::vector < float > vertices;
+		int faces[6][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 2, 1 }, { 1, 0, 2 }, { 2, 1, 0 } };
+		for (int face = 0; face < 6; face++) {
+			float side = face < 3 ? 0.5 : -0.5;
+			float corners[6][2] = { { -0.5, -0.5 }, { 0.5, 0.5 }, { 0.5, -0.5 }, { -0.5, -0.5 }, { -0.5, 0.5 }, { 0.5, 0.5 } };
+			for (int i = 0; i < 6; i++) {
+				float vertex[3];
+				vertex[faces[face][0]] = side;
+				vertex[faces[face][1]] = corners[i][0];
+				vertex[faces[face][2]] = corners[i][1];
+				vertices.insert(vertices.end(), vertex, vertex + 3);
+			}
+		}
+
+		glGenVertexArrays(1, &vertex_array);
+		gl_state.bind_vertex_array(vertex_array);
+
+		glGenBuffers(1, &vertex_buffer);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+		glEnableVertexAttribArray(0);
+		frame_counters.buffer_uploads++;
+
+		glGenBuffers(1, &proxy_buffer);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, proxy_buffer);
+		for (int i = 0; i < 5; i++) {
+			glVertexAttribPointer(1 + i, i < 4 ? 4 : 3, GL_FLOAT, GL_FALSE, sizeof(float) * PROXY_SIZE, (void*)(sizeof(float) * 4 * i));
+			glEnableVertexAttribArray(1 + i);
+			glVertexAttribDivisor(1 + i, 1);
+		}
+	}
+
+public:
+	void clear() {
+		proxies.clear();
+	}
+
+	void add(const mat4& model, Vect3 color) {
+		proxies.insert(proxies.end(), model.m, model.m + 16);
+		proxies.push_back(color.x);
+		proxies.push_back(color.y);
+		proxies.push_back(color.z);
+	}
+
+	int size() {
+		return proxies.size() / PROXY_SIZE;
+	}
+
+	void draw(Shader* proxy_shader, const mat4& view_projection) {
+		if (proxies.empty())
+			return;
+
+		create();
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, proxy_buffer);
+		if (proxies.size() > capacity) {
+			capacity = proxies.size();
+			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * capacity, proxies.data(), GL_STREAM_DRAW);
+		}
+		else {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * proxies.size(), proxies.data());
+		}
+		frame_counters.buffer_uploads++;
+
+		proxy_shader->use();
+		glUniformMatrix4fv(glGetUniformLocation(proxy_shader->program, "view_projection"), 1, GL_FALSE, view_projection.m);
+		frame_counters.uniform_uploads++;
+
+		gl_state.bind_vertex_array(vertex_array);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 36, size());
+
+		frame_counters.draw_calls++;
+		frame_counters.instances += size();
+		frame_counters.triangles += 12 * size();
+	}
+
+	void destroy() {
+		if (vertex_array == 0)
+			return;
+
+		gl_state.delete_vertex_array(vertex_array);
+		gl_state.delete_buffer(vertex_buffer);
+		gl_state.delete_buffer(proxy_buffer);
+		vertex_array = vertex_buffer = proxy_buffer = 0;
+		capacity = 0;
+	}
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <GL/glew.h>
+#include "GLState.h"
+#include "RenderStats.h"
+
+
+const int MATERIAL_SIZE = 16;
+
+
+class MaterialTable {
+	static const int MIN_CAPACITY = 64, MIN_MAX_MATERIALS = 16384;
+
+	bool overflowed = false;
+	int capacity = 0, max_materials = MIN_MAX_MATERIALS;
+	unsigned int generation = 0, buffer = 0, texture = 0;
+	std::vector < float > materials;
+	std::map < std::vector < float >, int > ids;
+
+	void upload(int begin, int end) {
+		gl_state.bind_buffer(GL_TEXTURE_BUFFER, buffer);
+		if (end > capacity) {
+			capacity = std::max(2 * capacity, end);
+			glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * MATERIAL_SIZE * capacity, NULL, GL_DYNAMIC_DRAW);
+			begin = 0;
+		}
+		glBufferSubData(GL_TEXTURE_BUFFER, sizeof(float) * MATERIAL_SIZE * begin, sizeof(float) * MATERIAL_SIZE * (end - begin), materials.data() + MATERIAL_SIZE * begin);
+		frame_counters.buffer_uploads++;
+	}
+
+	static unsigned int next_generation() {
+		static std::atomic < unsigned int > last_generation(0);
+		return ++last_generation;
+	}
+
+public:
+	MaterialTable() {
+		generation = next_generation();
+	}
+
+	MaterialTable(const MaterialTable& other) = delete;
+
+	MaterialTable& operator =(const MaterialTable& other) = delete;
+
+	void create() {
+		if (texture != 0)
+			return;
+
+		glGenBuffers(1, &buffer);
+		gl_state.bind_buffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * MATERIAL_SIZE * MIN_CAPACITY, NULL, GL_DYNAMIC_DRAW);
+		capacity = MIN_CAPACITY;
+
+		glGenTextures(1, &texture);
+		gl_state.bind_texture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+
+		int max_texels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+		max_materials = std::max(max_texels / (MATERIAL_SIZE / 4), (int)MIN_MAX_MATERIALS);
+
+		if (!materials.empty())
+			upload(0, size());
+	}
+
+	int get_id(const float* values) {
+		std::vector < float > key(values, values + MATERIAL_SIZE);
+		std::map < std::vector < float >, int >::iterator entry = ids.find(key);
+		if (entry != ids.end())
+			return entry->second;
+
+		if (size() >= max_materials) {
+			if (!overflowed)
+				std::cout << "ERROR::MATERIAL_TABLE::GET_ID\nMore than " << max_materials << " distinct materials, the table is cleared.\n";
+			overflowed = true;
+			clear();
+		}
+
+		int id = size();
+		ids[key] = id;
+		materials.insert(materials.end(), values, values + MATERIAL_SIZE);
+		if (texture != 0)
+			upload(id, id + 1);
+		return id;
+	}
+
+	unsigned int get_generation() {
+		return generation;
+	}
+
+	unsigned int get_texture() {
+		return texture;
+	}
+
+	int size() {
+		return materials.size() / MATERIAL_SIZE;
+	}
+
+	void clear() {
+		materials.clear();
+		ids.clear();
+		generation = next_generation();
+	}
+
+	void destroy() {
+		if (texture == 0)
+			return;
+
+		gl_state.delete_texture(texture);
+		gl_state.delete_buffer(buffer);
+		texture = buffer = 0;
+		capacity = 0;
+	}
+};
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <vector>
+#include "CommonClasses/Vect3.h"
+
+
+struct LodMesh {
+	std::vector < float > positions, normals, tex_coords;
+	std::vector < unsigned int > indices;
+
+	int get_count_vertices() {
+		return positions.size() / 3;
+	}
+
+	int get_count_triangles() {
+		return indices.size() / 3;
+	}
+
+	void append(std::vector < float > positions, std::vector < float > normals, std::vector < float > tex_coords, std::vector < unsigned int > indices) {
+		int offset = get_count_vertices();
+		this->positions.insert(this->positions.end(), positions.begin(), positions.end());
+		this->normals.insert(this->normals.end(), normals.begin(), normals.end());
+		this->tex_coords.insert(this->tex_coords.end(), tex_coords.begin(), tex_coords.end());
+		for (unsigned int index : indices)
+			this->indices.push_back(index + offset);
+	}
+};
+
+
+class MeshSimplifier {
+	struct Quadric {
+		double a[10] = { 0 }, weight = 0;
+
+		void add_plane(Vect3 normal, double d, double weight) {
+			this->weight += weight;
+			double plane[4] = { normal.x, normal.y, normal.z, d };
+			for (int i = 0, k = 0; i < 4; i++) {
+				for (int j = i; j < 4; j++, k++)
+					a[k] += weight * plane[i] * plane[j];
+			}
+		}
+
+		void operator +=(const Quadric& other) {
+			for (int i = 0; i < 10; i++)
+				a[i] += other.a[i];
+			weight += other.weight;
+		}
+
+		double evaluate(Vect3 p) const {
+			double x = p.x, y = p.y, z = p.z;
+			return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+				+ a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+				+ a[7] * z * z + 2 * a[8] * z
+				+ a[9];
+		}
+	};
+
+	struct Collapse {
+		double cost;
+		int from, to, version_from, version_to;
+		bool midpoint;
+
+		bool operator <(const Collapse& other) const {
+			return cost > other.cost;
+		}
+	};
+
+	double crease_cos, boundary_weight, eps = 0.00001;
+
+	int count_faces = 0;
+	std::vector < Vect3 > positions, normals, tex_coords;
+	std::vector < Quadric > quadrics;
+	std::vector < int > faces, versions;
+	std::vector < bool > face_removed, vertex_removed;
+	std::vector < int > vertex_group;
+	std::vector < std::vector < int > > vertex_faces, groups;
+	std::priority_queue < Collapse > collapses;
+
+	std::tuple < long long, long long, long long > get_key(Vect3 position) {
+		return std::make_tuple((long long)round(position.x / eps), (long long)round(position.y / eps), (long long)round(position.z / eps));
+	}
+
+	void weld(LodMesh& mesh, std::vector < int >& remap) {
+		std::map < std::tuple < long long, long long, long long >, std::vector < int > > groups;
+		std::vector < Vect3 > normal_sums;
+		this->groups.clear();
+
+		remap.resize(mesh.get_count_vertices());
+		for (int i = 0; i < mesh.get_count_vertices(); i++) {
+			Vect3 position(mesh.positions[3 * i], mesh.positions[3 * i + 1], mesh.positions[3 * i + 2]);
+			Vect3 normal(mesh.normals[3 * i], mesh.normals[3 * i + 1], mesh.normals[3 * i + 2]);
+			Vect3 tex_coord(mesh.tex_coords[2 * i], mesh.tex_coords[2 * i + 1], 0);
+			if (normal.length() > eps)
+				normal = normal.normalize();
+
+			std::vector < int >& group = groups[get_key(position)];
+			remap[i] = -1;
+			for (int id : group) {
+				if ((tex_coords[id] - tex_coord).length() < eps && normals[id] * normal >= crease_cos) {
+					remap[i] = id;
+					break;
+				}
+			}
+
+			if (remap[i] == -1) {
+				remap[i] = positions.size();
+				group.push_back(positions.size());
+				positions.push_back(position);
+				normals.push_back(normal);
+				tex_coords.push_back(tex_coord);
+				normal_sums.push_back(Vect3(0, 0, 0));
+			}
+			normal_sums[remap[i]] += normal;
+		}
+
+		vertex_group.assign(positions.size(), -1);
+		for (std::pair < const std::tuple < long long, long long, long long >, std::vector < int > >& group : groups) {
+			for (int id : group.second)
+				vertex_group[id] = this->groups.size();
+			this->groups.push_back(group.second);
+		}
+
+		for (int i = 0; i < positions.size(); i++) {
+			if (normal_sums[i].length() > eps)
+				normals[i] = normal_sums[i].normalize();
+		}
+	}
+
+	Vect3 get_face_normal(int face, int moved, Vect3 new_position) {
+		Vect3 p[3];
+		for (int i = 0; i < 3; i++)
+			p[i] = faces[3 * face + i] == moved ? new_position : positions[faces[3 * face + i]];
+		return (p[1] - p[0]) ^ (p[2] - p[0]);
+	}
+
+	void add_face_quadrics(int face) {
+		Vect3 p0 = positions[faces[3 * face]], p1 = positions[faces[3 * face + 1]], p2 = positions[faces[3 * face + 2]];
+		Vect3 normal = (p1 - p0) ^ (p2 - p0);
+		double area = normal.length() / 2;
+		if (area < eps * eps)
+			return;
+
+		normal = normal.normalize();
+		for (int i = 0; i < 3; i++)
+			quadrics[faces[3 * face + i]].add_plane(normal, -(normal * p0), area);
+	}
+
+	void add_boundary_quadrics() {
+		std::map < std::pair < int, int >, std::pair < int, int > > edges;
+		for (int face = 0; face < face_removed.size(); face++) {
+			if (face_removed[face])
+				continue;
+
+			for (int i = 0; i < 3; i++) {
+				int a = faces[3 * face + i], b = faces[3 * face + (i + 1) % 3];
+				std::pair < int, int >& edge = edges[{ std::min(a, b), std::max(a, b) }];
+				edge.first++;
+				edge.second = face;
+			}
+		}
+
+		for (std::pair < const std::pair < int, int >, std::pair < int, int > >& edge : edges) {
+			if (edge.second.first != 1)
+				continue;
+
+			int face = edge.second.second, a = edge.first.first, b = edge.first.second;
+			Vect3 face_normal = get_face_normal(face, -1, Vect3());
+			Vect3 direction = positions[b] - positions[a];
+			Vect3 normal = direction ^ face_normal;
+			if (normal.length() < eps * eps)
+				continue;
+
+			normal = normal.normalize();
+			double weight = boundary_weight * direction.length_sqr();
+			quadrics[a].add_plane(normal, -(normal * positions[a]), weight);
+			quadrics[b].add_plane(normal, -(normal * positions[a]), weight);
+		}
+	}
+
+	std::vector < int > get_neighbours(int vertex) {
+		std::vector < int > neighbours;
+		for (int face : vertex_faces[vertex]) {
+			if (face_removed[face])
+				continue;
+
+			for (int i = 0; i < 3; i++) {
+				if (faces[3 * face + i] != vertex)
+					neighbours.push_back(faces[3 * face + i]);
+			}
+		}
+
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		return neighbours;
+	}
+
+	bool get_pairs(int from, int to, std::vector < std::pair < int, int > >& pairs) {
+		pairs.clear();
+		for (int vertex : groups[vertex_group[from]]) {
+			if (vertex_removed[vertex])
+				continue;
+
+			int pair = vertex == from ? to : -1;
+			for (int neighbour : get_neighbours(vertex)) {
+				if (pair == -1 && vertex_group[neighbour] == vertex_group[to])
+					pair = neighbour;
+			}
+			if (pair == -1)
+				return false;
+
+			pairs.push_back({ vertex, pair });
+		}
+		return true;
+	}
+
+	bool is_single(int vertex) {
+		int count = 0;
+		for (int other : groups[vertex_group[vertex]])
+			count += !vertex_removed[other];
+		return count == 1;
+	}
+
+	double get_cost(std::vector < std::pair < int, int > >& pairs, Vect3 position) {
+		double cost = 0, weight = 0;
+		for (std::pair < int, int >& pair : pairs) {
+			Quadric quadric = quadrics[pair.first];
+			quadric += quadrics[pair.second];
+			cost += quadric.evaluate(position);
+			weight += quadric.weight;
+		}
+		return weight > 0 ? std::max(cost / weight, 0.0) : 0;
+	}
+
+	void push_collapse(int a, int b) {
+		if (vertex_removed[a] || vertex_removed[b] || vertex_group[a] == vertex_group[b])
+			return;
+
+		Collapse best = { INFINITY, -1, -1, 0, 0, false };
+		std::vector < std::pair < int, int > > pairs;
+		if (get_pairs(a, b, pairs))
+			best = { get_cost(pairs, positions[b]), a, b, versions[a], versions[b], false };
+		if (get_pairs(b, a, pairs) && get_cost(pairs, positions[a]) < best.cost)
+			best = { get_cost(pairs, positions[a]), b, a, versions[b], versions[a], false };
+		if (is_single(a) && is_single(b)) {
+			pairs = { { a, b } };
+			if (get_cost(pairs, (positions[a] + positions[b]) / 2) < best.cost)
+				best = { get_cost(pairs, (positions[a] + positions[b]) / 2), a, b, versions[a], versions[b], true };
+		}
+
+		if (best.from != -1)
+			collapses.push(best);
+	}
+
+	bool is_valid(int vertex, int other, Vect3 new_position) {
+		for (int face : vertex_faces[vertex]) {
+			if (face_removed[face] || faces[3 * face] == other || faces[3 * face + 1] == other || faces[3 * face + 2] == other)
+				continue;
+
+			Vect3 before = get_face_normal(face, -1, Vect3()), after = get_face_normal(face, vertex, new_position);
+			if (after.length() < eps * eps || before * after <= 0)
+				return false;
+		}
+		return true;
+	}
+
+	bool can_collapse(int from, int to, Vect3 new_position, bool midpoint) {
+		std::vector < int > neighbours_from = get_neighbours(from), neighbours_to = get_neighbours(to);
+		std::vector < int > common;
+		std::set_intersection(neighbours_from.begin(), neighbours_from.end(), neighbours_to.begin(), neighbours_to.end(), std::back_inserter(common));
+
+		int count_shared = 0;
+		for (int face : vertex_faces[from]) {
+			if (!face_removed[face] && (faces[3 * face] == to || faces[3 * face + 1] == to || faces[3 * face + 2] == to))
+				count_shared++;
+		}
+		if (common.size() != count_shared)
+			return false;
+
+		return is_valid(from, to, new_position) && (!midpoint || is_valid(to, from, new_position));
+	}
+
+	void apply_collapse(int from, int to, Vect3 new_position, bool midpoint) {
+		for (int face : vertex_faces[from]) {
+			if (face_removed[face])
+				continue;
+
+			bool shared = false;
+			for (int i = 0; i < 3; i++)
+				shared = shared || faces[3 * face + i] == to;
+
+			if (shared) {
+				face_removed[face] = true;
+				count_faces--;
+				continue;
+			}
+
+			for (int i = 0; i < 3; i++) {
+				if (faces[3 * face + i] == from)
+					faces[3 * face + i] = to;
+			}
+			vertex_faces[to].push_back(face);
+		}
+
+		if (midpoint) {
+			normals[to] = normals[from] + normals[to];
+			if (normals[to].length() > eps)
+				normals[to] = normals[to].normalize();
+			tex_coords[to] = (tex_coords[from] + tex_coords[to]) / 2;
+		}
+
+		positions[to] = new_position;
+		quadrics[to] += quadrics[from];
+		vertex_removed[from] = true;
+		versions[to]++;
+		vertex_faces[from].clear();
+	}
+
+	LodMesh build_mesh() {
+		LodMesh mesh;
+		std::vector < int > remap(positions.size(), -1);
+		for (int face = 0; face < face_removed.size(); face++) {
+			if (face_removed[face])
+				continue;
+
+			for (int i = 0; i < 3; i++) {
+				int vertex = faces[3 * face + i];
+				if (remap[vertex] == -1) {
+					remap[vertex] = mesh.get_count_vertices();
+					mesh.positions.insert(mesh.positions.end(), { (float)positions[vertex].x, (float)positions[vertex].y, (float)positions[vertex].z });
+					mesh.normals.insert(mesh.normals.end(), { (float)normals[vertex].x, (float)normals[vertex].y, (float)normals[vertex].z });
+					mesh.tex_coords.insert(mesh.tex_coords.end(), { (float)tex_coords[vertex].x, (float)tex_coords[vertex].y });
+				}
+				mesh.indices.push_back(remap[vertex]);
+			}
+		}
+		return mesh;
+	}
+
+public:
+	MeshSimplifier(double crease_angle = PI / 6, double boundary_weight = 10) {
+		crease_cos = cos(crease_angle);
+		this->boundary_weight = boundary_weight;
+	}
+
+	LodMesh simplify(LodMesh mesh, int target_triangles, double max_error = INFINITY) {
+		positions.clear();
+		normals.clear();
+		tex_coords.clear();
+		faces.clear();
+		collapses = std::priority_queue < Collapse >();
+
+		mesh.normals.resize(mesh.positions.size(), 0);
+		mesh.tex_coords.resize(2 * mesh.get_count_vertices(), 0);
+
+		std::vector < int > remap;
+		weld(mesh, remap);
+
+		for (int i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			int a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			faces.insert(faces.end(), { a, b, c });
+		}
+
+		count_faces = faces.size() / 3;
+		face_removed.assign(count_faces, false);
+		vertex_removed.assign(positions.size(), false);
+		versions.assign(positions.size(), 0);
+		quadrics.assign(positions.size(), Quadric());
+		vertex_faces.assign(positions.size(), std::vector < int >());
+
+		for (int face = 0; face < count_faces; face++) {
+			add_face_quadrics(face);
+			for (int i = 0; i < 3; i++)
+				vertex_faces[faces[3 * face + i]].push_back(face);
+		}
+		add_boundary_quadrics();
+
+		for (int face = 0; face < count_faces; face++) {
+			for (int i = 0; i < 3; i++)
+				push_collapse(faces[3 * face + i], faces[3 * face + (i + 1) % 3]);
+		}
+
+		while (count_faces > target_triangles && !collapses.empty()) {
+			Collapse collapse = collapses.top();
+			collapses.pop();
+
+			if (vertex_removed[collapse.from] || vertex_removed[collapse.to] || versions[collapse.from] != collapse.version_from || versions[collapse.to] != collapse.version_to)
+				continue;
+			if (collapse.cost > max_error)
+				break;
+
+			std::vector < std::pair < int, int > > pairs = { { collapse.from, collapse.to } };
+			if (!collapse.midpoint && !get_pairs(collapse.from, collapse.to, pairs))
+				continue;
+
+			Vect3 new_position = collapse.midpoint ? (positions[collapse.from] + positions[collapse.to]) / 2 : positions[collapse.to];
+			bool valid = true;
+			for (std::pair < int, int >& pair : pairs)
+				valid = valid && can_collapse(pair.first, pair.second, new_position, collapse.midpoint);
+			if (!valid)
+				continue;
+
+			for (std::pair < int, int >& pair : pairs)
+				apply_collapse(pair.first, pair.second, new_position, collapse.midpoint);
+			for (std::pair < int, int >& pair : pairs) {
+				for (int neighbour : get_neighbours(pair.second))
+					push_collapse(pair.second, neighbour);
+			}
+		}
+
+		return build_mesh();
+	}
+};
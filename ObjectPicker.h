@@ -0,0 +1,158 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <GL/glew.h>
+#include "GLState.h"
+#include "RenderTarget.h"
+
+
+struct PickResult {
+	int object_id = -1, instance_id = -1, polygon_id = -1;
+
+	bool operator <(const PickResult& other) const {
+		return std::tie(object_id, instance_id, polygon_id) < std::tie(other.object_id, other.instance_id, other.polygon_id);
+	}
+
+	bool operator ==(const PickResult& other) const {
+		return object_id == other.object_id && instance_id == other.instance_id && polygon_id == other.polygon_id;
+	}
+};
+
+
+struct PickRequest {
+	int id = -1, x = 0, y = 0, width = 0, height = 0;
+	unsigned int buffer = 0;
+	GLsync fence = 0;
+};
+
+
+class ObjectPicker {
+	int free_request_id = 0;
+	std::vector < PickRequest > requests, pending;
+	std::vector < unsigned int > free_buffers;
+	std::map < int, std::vector < PickResult > > results;
+
+	void read_results(PickRequest& request) {
+		std::vector < PickResult >& result = results[request.id];
+
+		gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+		int* pixels = (int*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(int) * 4 * request.width * request.height, GL_MAP_READ_BIT);
+		if (pixels != nullptr) {
+			for (int i = 0; i < request.width * request.height; i++) {
+				if (pixels[4 * i] < 0)
+					continue;
+
+				PickResult pick;
+				pick.object_id = pixels[4 * i];
+				pick.instance_id = pixels[4 * i + 1];
+				pick.polygon_id = pixels[4 * i + 2];
+				result.push_back(pick);
+			}
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+		free_buffers.push_back(request.buffer);
+	}
+
+	unsigned int get_buffer() {
+		if (free_buffers.empty()) {
+			unsigned int buffer;
+			glGenBuffers(1, &buffer);
+			return buffer;
+		}
+
+		unsigned int buffer = free_buffers.back();
+		free_buffers.pop_back();
+		return buffer;
+	}
+
+public:
+	int request(int x, int y, int width, int height) {
+		PickRequest request;
+		request.id = free_request_id++;
+		request.x = x;
+		request.y = y;
+		request.width = std::max(width, 1);
+		request.height = std::max(height, 1);
+		requests.push_back(request);
+		return request.id;
+	}
+
+	void read(RenderTarget& render_target, int window_width, int window_height) {
+		if (requests.empty())
+			return;
+
+		double scale_x = (double)render_target.width / std::max(window_width, 1), scale_y = (double)render_target.height / std::max(window_height, 1);
+		gl_state.bind_framebuffer(render_target.framebuffer);
+		glReadBuffer(GL_COLOR_ATTACHMENT1);
+
+		for (PickRequest& request : requests) {
+			int x0 = std::max((int)floor(request.x * scale_x), 0), x1 = std::min((int)ceil((request.x + request.width) * scale_x), render_target.width);
+			int y0 = std::max((int)floor(request.y * scale_y), 0), y1 = std::min((int)ceil((request.y + request.height) * scale_y), render_target.height);
+			if (render_target.pick_buffer == 0 || x0 >= x1 || y0 >= y1) {
+				results[request.id].clear();
+				continue;
+			}
+
+			request.width = x1 - x0;
+			request.height = y1 - y0;
+			request.buffer = get_buffer();
+			gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(int) * 4 * request.width * request.height, NULL, GL_STREAM_READ);
+			glReadPixels(x0, render_target.height - y1, request.width, request.height, GL_RGBA_INTEGER, GL_INT, 0);
+			request.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			pending.push_back(request);
+		}
+
+		gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		requests.clear();
+	}
+
+	void update() {
+		while (!pending.empty()) {
+			PickRequest& request = pending.front();
+			GLenum status = glClientWaitSync(request.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				return;
+
+			glDeleteSync(request.fence);
+			read_results(request);
+			pending.erase(pending.begin());
+		}
+	}
+
+	bool take_result(int id, std::vector < PickResult >& result) {
+		std::map < int, std::vector < PickResult > >::iterator entry = results.find(id);
+		if (entry == results.end())
+			return false;
+
+		result.swap(entry->second);
+		results.erase(entry);
+		return true;
+	}
+
+	void clear() {
+		for (PickRequest& request : pending) {
+			glDeleteSync(request.fence);
+			free_buffers.push_back(request.buffer);
+		}
+		requests.clear();
+		pending.clear();
+		results.clear();
+	}
+
+	void destroy() {
+		clear();
+		for (unsigned int buffer : free_buffers)
+			gl_state.delete_buffer(buffer);
+		free_buffers.clear();
+	}
+};
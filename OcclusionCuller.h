@@ -0,0 +1,299 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <GL/glew.h>
+#include "GLState.h"
+#include "Shader.h"
+#include "RenderTarget.h"
+#include "RenderStats.h"
+#include "CommonClasses/VectorMath.h"
+
+
+struct DepthLevel {
+	int width = 0, height = 0, shift = 0;
+	std::vector < float > depths;
+
+	float get_max(int x0, int y0, int x1, int y1) {
+		float res = 0;
+		for (int y = y0 >> shift; y <= (y1 >> shift); y++) {
+			for (int x = x0 >> shift; x <= (x1 >> shift); x++)
+				res = std::max(res, depths[y * width + x]);
+		}
+		return res;
+	}
+};
+
+
+struct DepthPyramid {
+	int width = 0, height = 0, base_width = 0, base_height = 0, shift = 0;
+	unsigned int texture = 0;
+	mat4 view_projection;
+};
+
+
+struct DepthReadback {
+	int width = 0, height = 0, base_width = 0, base_height = 0, shift = 0;
+	unsigned int buffer = 0;
+	GLsync fence = 0;
+	mat4 view_projection;
+};
+
+
+class OcclusionCuller {
+	static const int COUNT_FRAMES = 3;
+
+	int readback_size = 256, free_frame = 0, count_pending = 0;
+	int base_width = 0, base_height = 0;
+	std::vector < unsigned int > textures, framebuffers;
+	std::vector < int > widths, heights;
+	DepthReadback readbacks[COUNT_FRAMES];
+	DepthPyramid pyramid;
+
+	int depth_width = 0, depth_height = 0;
+	mat4 view_projection;
+	std::vector < DepthLevel > levels;
+
+	void delete_levels() {
+		for (int i = 0; i < textures.size(); i++) {
+			gl_state.delete_framebuffer(framebuffers[i]);
+			gl_state.delete_texture(textures[i]);
+		}
+		textures.clear();
+		framebuffers.clear();
+		pyramid.texture = 0;
+		widths.clear();
+		heights.clear();
+	}
+
+	void create_levels(int width, int height) {
+		if (width == base_width && height == base_height && !textures.empty())
+			return;
+
+		delete_levels();
+		base_width = width;
+		base_height = height;
+		do {
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+
+			unsigned int texture, framebuffer;
+			glGenFramebuffers(1, &framebuffer);
+			gl_state.bind_framebuffer(framebuffer);
+
+			glGenTextures(1, &texture);
+			gl_state.bind_texture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				std::cout << "ERROR::OCCLUSION_CULLER::CREATE_LEVELS\nFramebuffer is not complete.\n";
+
+			textures.push_back(texture);
+			framebuffers.push_back(framebuffer);
+			widths.push_back(width);
+			heights.push_back(height);
+		} while (std::max(width, height) > readback_size);
+	}
+
+	void read_levels(DepthReadback& readback) {
+		levels.assign(1, DepthLevel());
+		levels[0].width = readback.width;
+		levels[0].height = readback.height;
+		levels[0].shift = readback.shift;
+		levels[0].depths.resize(readback.width * readback.height);
+
+		gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		float* depths = (float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float) * levels[0].depths.size(), GL_MAP_READ_BIT);
+		if (depths != nullptr)
+			std::copy(depths, depths + levels[0].depths.size(), levels[0].depths.begin());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		while (levels.back().width > 1 || levels.back().height > 1) {
+			DepthLevel& source = levels.back();
+			DepthLevel level;
+			level.width = (source.width + 1) / 2;
+			level.height = (source.height + 1) / 2;
+			level.shift = source.shift + 1;
+			level.depths.resize(level.width * level.height);
+			for (int y = 0; y < level.height; y++) {
+				int y0 = 2 * y, y1 = std::min(2 * y + 1, source.height - 1);
+				for (int x = 0; x < level.width; x++) {
+					int x0 = 2 * x, x1 = std::min(2 * x + 1, source.width - 1);
+					level.depths[y * level.width + x] = std::max(std::max(source.depths[y0 * source.width + x0], source.depths[y0 * source.width + x1]), std::max(source.depths[y1 * source.width + x0], source.depths[y1 * source.width + x1]));
+				}
+			}
+			levels.push_back(level);
+		}
+
+		depth_width = readback.base_width;
+		depth_height = readback.base_height;
+		view_projection = readback.view_projection;
+	}
+
+public:
+	void create() {
+		for (DepthReadback& readback : readbacks)
+			glGenBuffers(1, &readback.buffer);
+		free_frame = 0;
+		count_pending = 0;
+	}
+
+	void set_readback_size(int readback_size) {
+		this->readback_size = std::max(readback_size, 1);
+		delete_levels();
+	}
+
+	bool is_ready() {
+		return !levels.empty();
+	}
+
+	DepthPyramid get_pyramid() {
+		return pyramid;
+	}
+
+	void update() {
+		while (count_pending > 0) {
+			DepthReadback& readback = readbacks[(free_frame - count_pending + COUNT_FRAMES) % COUNT_FRAMES];
+			GLenum status = glClientWaitSync(readback.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				return;
+
+			glDeleteSync(readback.fence);
+			readback.fence = 0;
+			count_pending--;
+			read_levels(readback);
+		}
+	}
+
+	void build(RenderTarget& render_target, Shader* depth_shader, unsigned int screen_coord_vao, const mat4& view_projection) {
+		if (readbacks[0].buffer == 0)
+			return;
+
+		create_levels(render_target.width, render_target.height);
+
+		depth_shader->use();
+		gl_state.set_capability(GL_DEPTH_TEST, false);
+		gl_state.set_capability(GL_STENCIL_TEST, false);
+		gl_state.set_capability(GL_BLEND, false);
+		gl_state.bind_vertex_array(screen_coord_vao);
+
+		for (int i = 0; i < textures.size(); i++) {
+			gl_state.bind_framebuffer(framebuffers[i]);
+			glViewport(0, 0, widths[i], heights[i]);
+			gl_state.bind_texture_unit(0, GL_TEXTURE_2D, i == 0 ? render_target.depth_stencil_buffer : textures[i - 1]);
+			glUniform2i(glGetUniformLocation(depth_shader->program, "source_size"), i == 0 ? render_target.width : widths[i - 1], i == 0 ? render_target.height : heights[i - 1]);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+
+			frame_counters.uniform_uploads++;
+			frame_counters.draw_calls++;
+			frame_counters.instances++;
+			frame_counters.triangles += 2;
+		}
+
+		pyramid.texture = textures.back();
+		pyramid.width = widths.back();
+		pyramid.height = heights.back();
+		pyramid.base_width = render_target.width;
+		pyramid.base_height = render_target.height;
+		pyramid.shift = textures.size();
+		pyramid.view_projection = view_projection;
+
+		if (count_pending < COUNT_FRAMES) {
+			DepthReadback& readback = readbacks[free_frame];
+			readback.width = pyramid.width;
+			readback.height = pyramid.height;
+			readback.base_width = pyramid.base_width;
+			readback.base_height = pyramid.base_height;
+			readback.shift = pyramid.shift;
+			readback.view_projection = view_projection;
+
+			gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float) * readback.width * readback.height, NULL, GL_STREAM_READ);
+			glReadPixels(0, 0, readback.width, readback.height, GL_RED, GL_FLOAT, 0);
+			gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+			readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			free_frame = (free_frame + 1) % COUNT_FRAMES;
+			count_pending++;
+		}
+
+		gl_state.bind_texture_unit(0, GL_TEXTURE_2D, 0);
+		gl_state.set_capability(GL_DEPTH_TEST, true);
+		gl_state.set_capability(GL_STENCIL_TEST, true);
+		gl_state.set_capability(GL_BLEND, true);
+	}
+
+	bool is_visible(const float* model, vec3 min_point, vec3 max_point) {
+		if (levels.empty())
+			return true;
+
+		float mvp[16];
+		for (int j = 0; j < 4; j++) {
+			for (int i = 0; i < 4; i++) {
+				mvp[4 * j + i] = 0;
+				for (int k = 0; k < 4; k++)
+					mvp[4 * j + i] += view_projection.m[4 * k + i] * model[4 * j + k];
+			}
+		}
+
+		float min_x = INFINITY, min_y = INFINITY, min_z = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+		for (int corner = 0; corner < 8; corner++) {
+			float x = corner & 1 ? max_point.x : min_point.x;
+			float y = corner & 2 ? max_point.y : min_point.y;
+			float z = corner & 4 ? max_point.z : min_point.z;
+
+			float clip[4];
+			for (int i = 0; i < 4; i++)
+				clip[i] = mvp[i] * x + mvp[4 + i] * y + mvp[8 + i] * z + mvp[12 + i];
+			if (clip[3] <= 0 || clip[2] < -clip[3])
+				return true;
+
+			min_x = std::min(min_x, clip[0] / clip[3]);
+			max_x = std::max(max_x, clip[0] / clip[3]);
+			min_y = std::min(min_y, clip[1] / clip[3]);
+			max_y = std::max(max_y, clip[1] / clip[3]);
+			min_z = std::min(min_z, clip[2] / clip[3]);
+		}
+
+		if (max_x < -1 || min_x > 1 || max_y < -1 || min_y > 1)
+			return true;
+
+		int x0 = std::min(std::max((int)floor((min_x * 0.5 + 0.5) * depth_width), 0), depth_width - 1);
+		int x1 = std::min(std::max((int)floor((max_x * 0.5 + 0.5) * depth_width), 0), depth_width - 1);
+		int y0 = std::min(std::max((int)floor((min_y * 0.5 + 0.5) * depth_height), 0), depth_height - 1);
+		int y1 = std::min(std::max((int)floor((max_y * 0.5 + 0.5) * depth_height), 0), depth_height - 1);
+
+		int level = 0;
+		while (level + 1 < levels.size() && (((x1 >> levels[level].shift) - (x0 >> levels[level].shift)) > 1 || ((y1 >> levels[level].shift) - (y0 >> levels[level].shift)) > 1))
+			level++;
+
+		return min_z * 0.5 + 0.5 <= levels[level].get_max(x0, y0, x1, y1);
+	}
+
+	void clear() {
+		for (DepthReadback& readback : readbacks) {
+			if (readback.fence != 0)
+				glDeleteSync(readback.fence);
+			readback.fence = 0;
+		}
+		count_pending = 0;
+		levels.clear();
+		pyramid.texture = 0;
+	}
+
+	void destroy() {
+		clear();
+		delete_levels();
+		for (DepthReadback& readback : readbacks) {
+			gl_state.delete_buffer(readback.buffer);
+			readback.buffer = 0;
+		}
+	}
+};
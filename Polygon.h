@@ -1,26 +1,41 @@
 #pragma once
 
+#include <stdint.h>
+#include <string.h>
 #include <cassert>
+#include <limits>
 #include <vector>
 #include "Shader.h"
 #include "Texture.h"
+#include "RenderStats.h"
+#include "InstanceStorage.h"
+#include "MaterialTable.h"
 #include "CommonClasses/Matrix.h"
 
 
+const int VERTEX_FORMAT_FLOAT = 0;
+const int VERTEX_FORMAT_PACKED = 1;
+
+
 class Material {
 public:
 	bool light = false;
 	double shininess = 1, alpha = 1;
 	Vect3 ambient = Vect3(0, 0, 0), diffuse = Vect3(0, 0, 0), specular = Vect3(0, 0, 0), emission = Vect3(0, 0, 0);
 
-	void use(Shader* shader_program) {
-		glUniform3f(glGetUniformLocation(shader_program->program, "object_material.ambient"), ambient.x, ambient.y, ambient.z);
-		glUniform3f(glGetUniformLocation(shader_program->program, "object_material.diffuse"), diffuse.x, diffuse.y, diffuse.z);
-		glUniform3f(glGetUniformLocation(shader_program->program, "object_material.specular"), specular.x, specular.y, specular.z);
-		glUniform3f(glGetUniformLocation(shader_program->program, "object_material.emission"), emission.x, emission.y, emission.z);
-		glUniform1f(glGetUniformLocation(shader_program->program, "object_material.shininess"), shininess);
-		glUniform1f(glGetUniformLocation(shader_program->program, "object_material.alpha"), alpha);
-		glUniform1i(glGetUniformLocation(shader_program->program, "object_material.light"), light);
+	void write(float* result) const {
+		float values[MATERIAL_SIZE] = {
+			(float)ambient.x, (float)ambient.y, (float)ambient.z, (float)shininess,
+			(float)diffuse.x, (float)diffuse.y, (float)diffuse.z, (float)alpha,
+			(float)specular.x, (float)specular.y, (float)specular.z, (float)light,
+			(float)emission.x, (float)emission.y, (float)emission.z, 0
+		};
+		std::copy(values, values + MATERIAL_SIZE, result);
+	}
+
+	bool operator ==(const Material& other) const {
+		return light == other.light && shininess == other.shininess && alpha == other.alpha
+			&& ambient == other.ambient && diffuse == other.diffuse && specular == other.specular && emission == other.emission;
 	}
 };
 
@@ -30,43 +45,247 @@ class Polygon {
 	Matrix polygon = one_matrix(4);
 	Shader* shader_program = nullptr;
 
-	int count_points;
+	bool dirty = false, dirty_normals = false;
+	int count_points, count_indices, revision = 0, material_index = -1, vertex_format = VERTEX_FORMAT_FLOAT;
+	GLenum index_type = GL_UNSIGNED_INT;
+	unsigned int material_generation = 0;
+	Material used_material;
 	unsigned int vertex_array, vertex_buffer, index_buffer;
-	std::vector < float > positions;
+	std::vector < unsigned int > indices;
+	PointArray positions, global_positions;
 	Vect3 center;
 
-	void create_vertex_array() {
-		glGenVertexArrays(1, &vertex_array);
-		glBindVertexArray(vertex_array);
+	static uint16_t to_half(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = (bits >> 16) & 0x8000, mantissa = bits & 0x7FFFFF;
+		int exponent = (int)((bits >> 23) & 0xFF) - 112;
+		if (exponent <= 0)
+			return sign;
+		if (exponent >= 31)
+			return sign | 0x7C00;
+		return (sign | (exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1);
+	}
 
-		glGenBuffers(1, &vertex_buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	static float from_half(uint16_t half) {
+		uint32_t sign = (uint32_t)(half & 0x8000) << 16, exponent = (half >> 10) & 0x1F, mantissa = half & 0x3FF;
+		uint32_t bits = sign;
+		if (exponent == 31)
+			bits |= 0x7F800000 | (mantissa << 13);
+		else if (exponent != 0)
+			bits |= ((exponent + 112) << 23) | (mantissa << 13);
+
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
 
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 8 * count_points, NULL, GL_STATIC_DRAW);
+	size_t get_position_size() {
+		return vertex_format == VERTEX_FORMAT_PACKED ? sizeof(uint16_t) * 4 : sizeof(float) * 3;
+	}
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-		glEnableVertexAttribArray(0);
+	size_t get_normal_size() {
+		return vertex_format == VERTEX_FORMAT_PACKED ? sizeof(uint32_t) : sizeof(float) * 3;
+	}
 
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(sizeof(float) * 3 * count_points));
-		glEnableVertexAttribArray(1);
+	size_t get_tex_coord_size() {
+		return vertex_format == VERTEX_FORMAT_PACKED ? sizeof(uint16_t) * 2 : sizeof(float) * 2;
+	}
+
+	size_t get_quantization_offset() {
+		return (get_position_size() + get_normal_size() + get_tex_coord_size()) * count_points;
+	}
+
+	size_t get_vertex_buffer_size() {
+		return get_quantization_offset() + sizeof(float) * 6;
+	}
 
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)(sizeof(float) * 6 * count_points));
-		glEnableVertexAttribArray(2);
+	void set_vertex_attributes() {
+		gl_state.bind_vertex_array(vertex_array);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+
+		size_t normals_offset = get_position_size() * count_points, tex_coords_offset = normals_offset + get_normal_size() * count_points;
+		if (vertex_format == VERTEX_FORMAT_PACKED) {
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, get_position_size(), 0);
+			glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, get_normal_size(), (void*)normals_offset);
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, get_tex_coord_size(), (void*)tex_coords_offset);
+		}
+		else {
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, get_position_size(), 0);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, get_normal_size(), (void*)normals_offset);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, get_tex_coord_size(), (void*)tex_coords_offset);
+		}
+		for (int i = 0; i < 3; i++)
+			glEnableVertexAttribArray(i);
+
+		for (int i = 0; i < 2; i++) {
+			glVertexAttribPointer(12 + i, 3, GL_FLOAT, GL_FALSE, 0, (void*)(get_quantization_offset() + sizeof(float) * 3 * i));
+			glEnableVertexAttribArray(12 + i);
+			glVertexAttribDivisor(12 + i, std::numeric_limits < GLuint >::max());
+		}
+
+		gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	}
+
+	void write_quantization(vec3 offset, vec3 scale) {
+		float quantization[] = { offset.x, offset.y, offset.z, scale.x, scale.y, scale.z };
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, get_quantization_offset(), sizeof(quantization), quantization);
+	}
+
+	void write_positions() {
+		if (count_points == 0 || global_positions.size() != count_points)
+			return;
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		if (vertex_format != VERTEX_FORMAT_PACKED) {
+			std::vector < float > vertices = global_positions.interleave();
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * vertices.size(), vertices.data());
+			frame_counters.buffer_uploads++;
+			return;
+		}
+
+		vec3 min_point, max_point;
+		::get_bounding_box(global_positions.span(), min_point, max_point);
+		vec3 scale = { max_point.x - min_point.x, max_point.y - min_point.y, max_point.z - min_point.z };
+		float* scales[] = { &scale.x, &scale.y, &scale.z };
+		for (float* value : scales) {
+			if (*value <= 0)
+				*value = 1;
+		}
+
+		std::vector < uint16_t > vertices(4 * count_points, 0);
+		for (int i = 0; i < count_points; i++) {
+			vec3 point = global_positions.get(i);
+			vertices[4 * i] = (uint16_t)round((point.x - min_point.x) / scale.x * 65535);
+			vertices[4 * i + 1] = (uint16_t)round((point.y - min_point.y) / scale.y * 65535);
+			vertices[4 * i + 2] = (uint16_t)round((point.z - min_point.z) / scale.z * 65535);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(uint16_t) * vertices.size(), vertices.data());
+		write_quantization(min_point, scale);
+		frame_counters.buffer_uploads++;
+	}
+
+	void write_normals(const float* normals) {
+		if (count_points == 0)
+			return;
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		if (vertex_format != VERTEX_FORMAT_PACKED) {
+			glBufferSubData(GL_ARRAY_BUFFER, get_position_size() * count_points, sizeof(float) * 3 * count_points, normals);
+			frame_counters.buffer_uploads++;
+			return;
+		}
 
+		std::vector < uint32_t > packed(count_points);
+		for (int i = 0; i < count_points; i++) {
+			Vect3 normal(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+			if (normal.length() > 0)
+				normal = normal.normalize();
+
+			double components[] = { normal.x, normal.y, normal.z };
+			packed[i] = 0;
+			for (int j = 0; j < 3; j++)
+				packed[i] |= ((uint32_t)(int)round(components[j] * 511) & 0x3FF) << (10 * j);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, get_position_size() * count_points, sizeof(uint32_t) * count_points, packed.data());
+		frame_counters.buffer_uploads++;
+	}
+
+	void write_tex_coords(const float* tex_coords) {
+		if (count_points == 0)
+			return;
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		size_t offset = (get_position_size() + get_normal_size()) * count_points;
+		if (vertex_format != VERTEX_FORMAT_PACKED) {
+			glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(float) * 2 * count_points, tex_coords);
+			frame_counters.buffer_uploads++;
+			return;
+		}
+
+		std::vector < uint16_t > packed(2 * count_points);
+		for (int i = 0; i < 2 * count_points; i++)
+			packed[i] = to_half(tex_coords[i]);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(uint16_t) * packed.size(), packed.data());
+		frame_counters.buffer_uploads++;
+	}
+
+	std::vector < float > read_normals() {
+		std::vector < float > normals(3 * count_points);
+		if (count_points == 0)
+			return normals;
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		if (vertex_format != VERTEX_FORMAT_PACKED) {
+			glGetBufferSubData(GL_ARRAY_BUFFER, get_position_size() * count_points, sizeof(float) * normals.size(), normals.data());
+			return normals;
+		}
+
+		std::vector < uint32_t > packed(count_points);
+		glGetBufferSubData(GL_ARRAY_BUFFER, get_position_size() * count_points, sizeof(uint32_t) * packed.size(), packed.data());
+		for (int i = 0; i < count_points; i++) {
+			for (int j = 0; j < 3; j++) {
+				int component = (packed[i] >> (10 * j)) & 0x3FF;
+				if (component >= 512)
+					component -= 1024;
+				normals[3 * i + j] = std::max(component / 511.0f, -1.0f);
+			}
+		}
+		return normals;
+	}
+
+	std::vector < float > read_tex_coords() {
+		std::vector < float > tex_coords(2 * count_points);
+		if (count_points == 0)
+			return tex_coords;
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		size_t offset = (get_position_size() + get_normal_size()) * count_points;
+		if (vertex_format != VERTEX_FORMAT_PACKED) {
+			glGetBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(float) * tex_coords.size(), tex_coords.data());
+			return tex_coords;
+		}
+
+		std::vector < uint16_t > packed(2 * count_points);
+		glGetBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(uint16_t) * packed.size(), packed.data());
+		for (int i = 0; i < 2 * count_points; i++)
+			tex_coords[i] = from_half(packed[i]);
+		return tex_coords;
+	}
+
+	void write_indices(const unsigned int* indices, int count) {
+		index_type = count_points <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+		gl_state.bind_vertex_array(vertex_array);
+		gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		if (index_type == GL_UNSIGNED_SHORT) {
+			std::vector < uint16_t > short_indices(indices, indices + count);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * count, short_indices.data(), GL_STATIC_DRAW);
+		}
+		else {
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * count, indices, GL_STATIC_DRAW);
+		}
+	}
+
+	void create_vertex_array() {
+		glGenVertexArrays(1, &vertex_array);
+		glGenBuffers(1, &vertex_buffer);
 		glGenBuffers(1, &index_buffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
 
-		unsigned int* indices = new unsigned int[(count_points - 2) * 3];
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, get_vertex_buffer_size(), NULL, GL_STATIC_DRAW);
+		write_quantization({ 0, 0, 0 }, { 1, 1, 1 });
+		set_vertex_attributes();
+
+		count_indices = std::max(count_points - 2, 0) * 3;
+		std::vector < unsigned int > fan_indices(count_indices);
 		for (int i = 0; i < count_points - 2; i++) {
-			indices[3 * i] = 0;
-			indices[3 * i + 1] = i + 1;
-			indices[3 * i + 2] = i + 2;
+			fan_indices[3 * i] = 0;
+			fan_indices[3 * i + 1] = i + 1;
+			fan_indices[3 * i + 2] = i + 2;
 		}
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * (count_points - 2) * 3, indices, GL_STATIC_DRAW);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		write_indices(fan_indices.data(), count_indices);
 	}
 
 public:
@@ -76,6 +295,7 @@ public:
 	Material material;
 
 	Polygon(const Polygon& object) {
+		id = object.id;
 		polygon = object.polygon;
 		shader_program = object.shader_program;
 		count_points = object.count_points;
@@ -85,21 +305,19 @@ public:
 		emission_map = object.emission_map;
 		material = object.material;
 		positions = object.positions;
+		global_positions = object.global_positions;
+		dirty = object.dirty;
+		dirty_normals = object.dirty_normals;
+		vertex_format = object.vertex_format;
 
 		create_vertex_array();
 		set_matrix_buffer(object.matrix_buffer);
+		if (!object.indices.empty())
+			set_indices(object.indices);
 
-		glBindVertexArray(vertex_array);
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-		glBindBuffer(GL_COPY_READ_BUFFER, object.vertex_buffer);
-		glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
-		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(float) * 8 * count_points);
-		glBindBuffer(GL_COPY_READ_BUFFER, 0);
-		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		gl_state.bind_buffer(GL_COPY_READ_BUFFER, object.vertex_buffer);
+		gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, get_vertex_buffer_size());
 	}
 
 	Polygon(int count_points = 0, Shader* shader = nullptr) {
@@ -110,119 +328,267 @@ public:
 	}
 
 	void set_positions(std::vector < float > positions, bool update_normals = true) {
-		this->positions = positions;
-		positions = get_positions();
-
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 3 * count_points, &positions[0]);
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		center = Vect3(0, 0, 0);
-		for (int i = 0; i < count_points; i++)
-			center += Vect3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
-		center /= count_points;
+		this->positions = PointArray(positions);
+		dirty = true;
+		revision++;
+		dirty_normals = dirty_normals || update_normals;
+	}
 
-		if (update_normals) {
-			Vect3 p0(positions[0], positions[1], positions[2]);
-			Vect3 p1(positions[3], positions[4], positions[5]);
-			Vect3 p2(positions[6], positions[7], positions[8]);
-			Vect3 normal = (p2 - p0) ^ (p1 - p0);
+	void set_normals(std::vector < float > normals) {
+		dirty_normals = false;
+		revision++;
+		write_normals(normals.data());
+	}
 
-			std::vector < float > normals(3 * count_points);
-			for (int i = 0; i < count_points; i++) {
-				normals[3 * i] = normal.x;
-				normals[3 * i + 1] = normal.y;
-				normals[3 * i + 2] = normal.z;
+	void set_indices(std::vector < unsigned int > indices) {
+		for (unsigned int index : indices) {
+			if (index >= (unsigned int)count_points) {
+				std::cout << "ERROR::POLYGON::SET_INDICES\nIndex " << index << " is out of range.\n";
+				return;
 			}
-			set_normals(normals);
 		}
-	}
-
-	void set_normals(std::vector < float > normals) {
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
 
-		glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 3 * count_points, sizeof(float) * 3 * count_points, &normals[0]);
+		this->indices = indices;
+		count_indices = indices.size() - indices.size() % 3;
+		revision++;
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		write_indices(indices.data(), count_indices);
+		frame_counters.buffer_uploads++;
 	}
 
 	void set_tex_coords(std::vector < float > tex_coords) {
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+		revision++;
+		write_tex_coords(tex_coords.data());
+	}
+
+	void set_vertex_format(int vertex_format) {
+		if (vertex_format != VERTEX_FORMAT_FLOAT && vertex_format != VERTEX_FORMAT_PACKED) {
+			std::cout << "ERROR::POLYGON::SET_VERTEX_FORMAT\nUnknown vertex format " << vertex_format << ".\n";
+			return;
+		}
+		if (this->vertex_format == vertex_format)
+			return;
 
-		glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 6 * count_points, sizeof(float) * 2 * count_points, &tex_coords[0]);
+		flush();
+		std::vector < float > normals = get_normals(), tex_coords = get_tex_coords();
+		this->vertex_format = vertex_format;
+		revision++;
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, get_vertex_buffer_size(), NULL, GL_STATIC_DRAW);
+		write_quantization({ 0, 0, 0 }, { 1, 1, 1 });
+		set_vertex_attributes();
+		write_positions();
+		write_normals(normals.data());
+		write_tex_coords(tex_coords.data());
+	}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	int get_vertex_format() {
+		return vertex_format;
 	}
 
 	void set_shader(Shader* shader) {
 		shader_program = shader;
 	}
 
-	void set_uniforms() {
+	void set_uniforms(MaterialTable& material_table) {
 		if (shader_program == nullptr)
 			return;
 
 		shader_program->use();
+		set_textures();
+		glUniform1i(glGetUniformLocation(shader_program->program, "material_index"), get_material_index(material_table));
+		glUniform1i(glGetUniformLocation(shader_program->program, "pick_polygon"), id);
+		frame_counters.uniform_uploads += 2;
+	}
+
+	int get_material_index(MaterialTable& material_table) {
+		if (material_index < 0 || material_generation != material_table.get_generation() || !(used_material == material)) {
+			float values[MATERIAL_SIZE];
+			material.write(values);
+			material_index = material_table.get_id(values);
+			material_generation = material_table.get_generation();
+			used_material = material;
+		}
+		return material_index;
+	}
+
+	void set_textures() {
+		if (shader_program == nullptr)
+			return;
+
 		glUniform1i(glGetUniformLocation(shader_program->program, "use_diffuse_map"), diffuse_map.texture_id);
 		glUniform1i(glGetUniformLocation(shader_program->program, "use_specular_map"), specular_map.texture_id);
 		glUniform1i(glGetUniformLocation(shader_program->program, "use_emission_map"), emission_map.texture_id);
-
-		material.use(shader_program);
+		frame_counters.uniform_uploads += 3;
 
 		diffuse_map.active(0);
 		specular_map.active(1);
 		emission_map.active(2);
 	}
 
-	void set_matrix_buffer(unsigned int matrix_buffer) {
+	void set_matrix_buffer(unsigned int matrix_buffer, int first_instance = 0) {
 		if (matrix_buffer == 0)
 			return;
 
 		this->matrix_buffer = matrix_buffer;
 
-		glBindBuffer(GL_ARRAY_BUFFER, matrix_buffer);
-		glBindVertexArray(vertex_array);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, matrix_buffer);
+		gl_state.bind_vertex_array(vertex_array);
 
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (void*)0);
-		glEnableVertexAttribArray(3);
+		size_t offset = sizeof(float) * INSTANCE_SIZE * first_instance;
+		for (int i = 0; i < 4; i++) {
+			glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(float) * INSTANCE_SIZE, (void*)(offset + sizeof(float) * 4 * i));
+			glEnableVertexAttribArray(3 + i);
+			glVertexAttribDivisor(3 + i, 1);
+		}
 
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (void*)(sizeof(float) * 4));
-		glEnableVertexAttribArray(4);
+		for (int i = 0; i < 3; i++) {
+			glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, sizeof(float) * INSTANCE_SIZE, (void*)(offset + sizeof(float) * (16 + 3 * i)));
+			glEnableVertexAttribArray(7 + i);
+			glVertexAttribDivisor(7 + i, 1);
+		}
 
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (void*)(sizeof(float) * 8));
-		glEnableVertexAttribArray(5);
+		glVertexAttribPointer(11, 1, GL_FLOAT, GL_FALSE, sizeof(float) * INSTANCE_SIZE, (void*)(offset + sizeof(float) * 25));
+		glEnableVertexAttribArray(11);
+		glVertexAttribDivisor(11, 1);
+	}
 
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (void*)(sizeof(float) * 12));
-		glEnableVertexAttribArray(6);
+	void release_vertex_array() {
+		gl_state.delete_vertex_array(vertex_array);
+		vertex_array = 0;
+	}
 
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
+	void recreate_vertex_array() {
+		if (vertex_array != 0)
+			gl_state.delete_vertex_array(vertex_array);
 
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glGenVertexArrays(1, &vertex_array);
+		set_vertex_attributes();
+		set_matrix_buffer(matrix_buffer);
 	}
 
 	int get_count_points() {
 		return count_points;
 	}
 
+	void flush() {
+		if (!dirty)
+			return;
+
+		global_positions.resize(positions.size());
+		transform_points(polygon.get_mat4(), positions.span(), global_positions.span());
+		center = Vect3(get_centroid(global_positions.span()));
+
+		std::vector < float > normals;
+		if (dirty_normals) {
+			Vect3 p0(global_positions.get(0));
+			Vect3 p1(global_positions.get(1));
+			Vect3 p2(global_positions.get(2));
+			Vect3 normal = (p2 - p0) ^ (p1 - p0);
+
+			normals.resize(3 * count_points);
+			for (int i = 0; i < count_points; i++) {
+				normals[3 * i] = normal.x;
+				normals[3 * i + 1] = normal.y;
+				normals[3 * i + 2] = normal.z;
+			}
+		}
+
+		if (vertex_format == VERTEX_FORMAT_PACKED) {
+			write_positions();
+			if (dirty_normals)
+				write_normals(normals.data());
+		}
+		else if (count_points > 0) {
+			std::vector < float > vertices = global_positions.interleave();
+			vertices.insert(vertices.end(), normals.begin(), normals.end());
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * vertices.size(), vertices.data());
+			frame_counters.buffer_uploads++;
+		}
+
+		dirty = false;
+		dirty_normals = false;
+	}
+
+	void load_vertices(const float* vertices, const unsigned int* indices, int count_indices) {
+		positions.resize(count_points);
+		for (int i = 0; i < count_points; i++)
+			positions.set(i, { vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2] });
+		global_positions = positions;
+		center = Vect3(get_centroid(global_positions.span()));
+		polygon = one_matrix(4);
+		dirty = false;
+		dirty_normals = false;
+		revision++;
+
+		write_positions();
+		write_normals(vertices + 3 * count_points);
+		write_tex_coords(vertices + 6 * count_points);
+
+		this->indices.assign(indices, indices + count_indices);
+		this->count_indices = count_indices - count_indices % 3;
+		write_indices(indices, this->count_indices);
+		frame_counters.buffer_uploads++;
+	}
+
+	std::vector < float > get_vertices() {
+		flush();
+
+		std::vector < float > vertices = global_positions.interleave(), normals = read_normals(), tex_coords = read_tex_coords();
+		vertices.insert(vertices.end(), normals.begin(), normals.end());
+		vertices.insert(vertices.end(), tex_coords.begin(), tex_coords.end());
+		return vertices;
+	}
+
 	std::vector < float > get_positions() {
-		std::vector < float > global_positions;
-		for (int i = 0; i < count_points; i++) {
-			Vect3 pos(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
-			pos = polygon * pos;
-			for (int j = 0; j < 3; j++)
-				global_positions.push_back(pos[j]);
+		flush();
+		return global_positions.interleave();
+	}
+
+	std::vector < float > get_normals() {
+		flush();
+		return read_normals();
+	}
+
+	std::vector < float > get_tex_coords() {
+		return read_tex_coords();
+	}
+
+	std::vector < unsigned int > get_indices() {
+		if (!indices.empty())
+			return indices;
+
+		std::vector < unsigned int > fan_indices;
+		for (int i = 0; i < count_points - 2; i++) {
+			fan_indices.push_back(0);
+			fan_indices.push_back(i + 1);
+			fan_indices.push_back(i + 2);
 		}
-		return global_positions;
+		return fan_indices;
+	}
+
+	int get_count_triangles() {
+		return count_indices / 3;
+	}
+
+	int get_revision() {
+		return revision;
+	}
+
+	unsigned int get_vertex_buffer() {
+		return vertex_buffer;
 	}
 
 	Vect3 get_center() {
-		return polygon * center;
+		flush();
+		return center;
+	}
+
+	void get_bounding_box(vec3& min_point, vec3& max_point) {
+		flush();
+		::get_bounding_box(global_positions.span(), min_point, max_point);
 	}
 
 	int get_vao() {
@@ -231,31 +597,28 @@ public:
 
 	void change_matrix(Matrix trans) {
 		polygon = trans * polygon;
-		set_positions(positions);
+		dirty = true;
+		dirty_normals = true;
+		revision++;
 	}
 
-	void delete_uniforms() {
+	void draw(int count) {
 		if (shader_program == nullptr)
 			return;
 
-		shader_program->use();
-		emission_map.deactive(2);
-		specular_map.deactive(1);
-		diffuse_map.deactive(0);
-	}
+		flush();
 
-	void draw(int count) {
-		if (shader_program == nullptr)
-			return;
+		gl_state.bind_vertex_array(vertex_array);
+		glDrawElementsInstanced(GL_TRIANGLES, count_indices, index_type, 0, count);
 
-		glBindVertexArray(vertex_array);
-		glDrawElementsInstanced(GL_TRIANGLES, (count_points - 2) * 3, GL_UNSIGNED_INT, 0, count);
-		glBindVertexArray(0);
+		frame_counters.draw_calls++;
+		frame_counters.instances += count;
+		frame_counters.triangles += (long long)(count_indices / 3) * count;
 	}
 
 	~Polygon() {
-		glDeleteVertexArrays(1, &vertex_array);
-		glDeleteBuffers(1, &vertex_buffer);
-		glDeleteBuffers(1, &index_buffer);
+		gl_state.delete_vertex_array(vertex_array);
+		gl_state.delete_buffer(vertex_buffer);
+		gl_state.delete_buffer(index_buffer);
 	}
 };
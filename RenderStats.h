@@ -0,0 +1,62 @@
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+
+struct FrameCounters {
+	long long draw_calls = 0, instances = 0, triangles = 0, uniform_uploads = 0, buffer_uploads = 0, texture_binds = 0, elided_state_calls = 0, culled_instances = 0;
+};
+
+inline thread_local FrameCounters frame_counters;
+
+
+struct StatValue {
+	double last = 0, min = 0, avg = 0, p99 = 0;
+};
+
+
+class StatHistory {
+	int free_id = 0, count = 0;
+	std::vector < double > values;
+
+public:
+	StatHistory(int size = 120) {
+		values.resize(std::max(size, 1), 0);
+	}
+
+	void push(double value) {
+		values[free_id] = value;
+		free_id = (free_id + 1) % values.size();
+		count = std::min(count + 1, (int)values.size());
+	}
+
+	StatValue get() {
+		StatValue result;
+		if (count == 0)
+			return result;
+
+		std::vector < double > sorted(count);
+		for (int i = 0; i < count; i++)
+			sorted[i] = values[(free_id - 1 - i + 2 * values.size()) % values.size()];
+		result.last = sorted[0];
+
+		double sum = 0;
+		for (double value : sorted)
+			sum += value;
+		result.avg = sum / count;
+
+		std::sort(sorted.begin(), sorted.end());
+		result.min = sorted[0];
+		result.p99 = sorted[std::min((int)ceil(0.99 * count) - 1, count - 1)];
+		return result;
+	}
+};
+
+
+struct RenderStats {
+	StatValue gpu_frame, gpu_lights, gpu_opaque, gpu_transparent, gpu_post;
+	StatValue draw_calls, instances, triangles, uniform_uploads, buffer_uploads, texture_binds, elided_state_calls, culled_instances;
+	FrameCounters last_frame;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <iostream>
+#include <GL/glew.h>
+#include "GLState.h"
+
+
+class RenderTarget {
+public:
+	int width = 0, height = 0;
+	unsigned int framebuffer = 0, tex_color_buffer = 0, depth_stencil_buffer = 0, pick_buffer = 0, outline_buffer = 0;
+	unsigned int accum_buffer = 0, weight_buffer = 0;
+
+	void create_color_texture(unsigned int& texture, GLenum format, GLenum attachment) {
+		glGenTextures(1, &texture);
+		gl_state.bind_texture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+	}
+
+	void create(int width, int height, bool picking = false, GLenum color_format = GL_RGBA16F, bool weighted_blend = false) {
+		this->width = width;
+		this->height = height;
+
+		glGenFramebuffers(1, &framebuffer);
+		gl_state.bind_framebuffer(framebuffer);
+
+		glGenTextures(1, &tex_color_buffer);
+		gl_state.bind_texture(GL_TEXTURE_2D, tex_color_buffer);
+		glTexImage2D(GL_TEXTURE_2D, 0, color_format, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_color_buffer, 0);
+
+		glGenTextures(1, &depth_stencil_buffer);
+		gl_state.bind_texture(GL_TEXTURE_2D, depth_stencil_buffer);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_stencil_buffer, 0);
+
+		if (picking) {
+			glGenTextures(1, &pick_buffer);
+			gl_state.bind_texture(GL_TEXTURE_2D, pick_buffer);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32I, width, height, 0, GL_RGBA_INTEGER, GL_INT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, pick_buffer, 0);
+		}
+
+		glGenTextures(1, &outline_buffer);
+		gl_state.bind_texture(GL_TEXTURE_2D, outline_buffer);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, outline_buffer, 0);
+
+		if (weighted_blend) {
+			create_color_texture(accum_buffer, GL_RGBA16F, GL_COLOR_ATTACHMENT3);
+			create_color_texture(weight_buffer, GL_R16F, GL_COLOR_ATTACHMENT4);
+		}
+		set_draw_buffers(false);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::RENDER_TARGET::CREATE\nFramebuffer is not complete.\n";
+	}
+
+	bool is_created() {
+		return framebuffer != 0;
+	}
+
+	void set_draw_buffers(bool weighted_blend, bool ids = true) {
+		GLenum draw_buffers[] = {
+			weighted_blend ? (GLenum)GL_COLOR_ATTACHMENT3 : (GLenum)GL_COLOR_ATTACHMENT0,
+			ids && pick_buffer != 0 ? (GLenum)GL_COLOR_ATTACHMENT1 : (GLenum)GL_NONE,
+			ids ? (GLenum)GL_COLOR_ATTACHMENT2 : (GLenum)GL_NONE,
+			weighted_blend ? (GLenum)GL_COLOR_ATTACHMENT4 : (GLenum)GL_NONE
+		};
+		glDrawBuffers(4, draw_buffers);
+	}
+
+	void clear_weighted_buffers() {
+		float accum[] = { 0, 0, 0, 1 }, weight[] = { 0, 0, 0, 0 };
+		glClearBufferfv(GL_COLOR, 0, accum);
+		glClearBufferfv(GL_COLOR, 3, weight);
+	}
+
+	void clear_id_buffers() {
+		unsigned int no_outline[] = { 0, 0, 0, 0 };
+		glClearBufferuiv(GL_COLOR, 2, no_outline);
+
+		if (pick_buffer == 0)
+			return;
+
+		int empty[] = { -1, -1, -1, -1 };
+		glClearBufferiv(GL_COLOR, 1, empty);
+	}
+
+	void destroy() {
+		if (!is_created())
+			return;
+
+		gl_state.delete_framebuffer(framebuffer);
+		gl_state.delete_texture(tex_color_buffer);
+		gl_state.delete_texture(depth_stencil_buffer);
+		gl_state.delete_texture(outline_buffer);
+		if (pick_buffer != 0)
+			gl_state.delete_texture(pick_buffer);
+		if (accum_buffer != 0) {
+			gl_state.delete_texture(accum_buffer);
+			gl_state.delete_texture(weight_buffer);
+		}
+		framebuffer = 0;
+		tex_color_buffer = 0;
+		depth_stencil_buffer = 0;
+		pick_buffer = 0;
+		outline_buffer = 0;
+		accum_buffer = 0;
+		weight_buffer = 0;
+		width = 0;
+		height = 0;
+	}
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <GL/glew.h>
+#include <SFML/Graphics.hpp>
+#include "GraphObject.h"
+
+
+struct PendingObject {
+	int id = -1;
+	std::unique_ptr < GraphObject > object;
+	std::atomic < GLsync > fence;
+
+	PendingObject() {
+		fence.store(0);
+	}
+};
+
+
+class ResourceLoader {
+	bool stopping = false;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque < std::function < void() > > jobs;
+
+	void run() {
+		sf::Context context;
+		context.setActive(true);
+
+		while (true) {
+			std::function < void() > job;
+			{
+				std::unique_lock < std::mutex > lock(mutex);
+				condition.wait(lock, [&]() { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+					return;
+
+				job = jobs.front();
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+public:
+	ResourceLoader() {
+	}
+
+	ResourceLoader(const ResourceLoader& other) = delete;
+
+	ResourceLoader& operator =(const ResourceLoader& other) = delete;
+
+	bool is_running() {
+		return thread.joinable();
+	}
+
+	void start() {
+		if (is_running())
+			return;
+
+		stopping = false;
+		thread = std::thread(&ResourceLoader::run, this);
+	}
+
+	void submit(std::function < void() > job) {
+		start();
+		{
+			std::lock_guard < std::mutex > lock(mutex);
+			jobs.push_back(job);
+		}
+		condition.notify_one();
+	}
+
+	std::shared_ptr < PendingObject > load_object(int id, std::function < GraphObject() > builder) {
+		std::shared_ptr < PendingObject > pending = std::make_shared < PendingObject >();
+		pending->id = id;
+		submit([pending, builder]() {
+			GraphObject object = builder();
+			pending->object.reset(new GraphObject());
+			pending->object->swap(object);
+			pending->object->flush();
+			pending->object->release_vertex_arrays();
+			pending->fence.store(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::memory_order_release);
+			glFlush();
+		});
+		return pending;
+	}
+
+	void stop() {
+		if (!is_running())
+			return;
+
+		{
+			std::lock_guard < std::mutex > lock(mutex);
+			stopping = true;
+		}
+		condition.notify_one();
+		thread.join();
+	}
+
+	~ResourceLoader() {
+		stop();
+	}
+};
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "GraphObject.h"
+#include "Light.h"
+
+
+const char SCENE_FILE_MAGIC[8] = { 'G', 'E', 'S', 'C', 'E', 'N', 'E', 0 };
+const uint32_t SCENE_FILE_VERSION = 5;
+const uint64_t SCENE_FILE_ALIGNMENT = 64;
+const uint32_t SCENE_FILE_MAX_MODELS = 1 << 24;
+
+const uint32_t SCENE_OBJECT_BORDER = 1;
+const uint32_t SCENE_OBJECT_TRANSPARENT = 2;
+
+const int SCENE_LIGHT_NONE = -1;
+const int SCENE_LIGHT_DIR = 0;
+const int SCENE_LIGHT_POINT = 1;
+const int SCENE_LIGHT_SPOT = 2;
+
+
+struct SceneFileHeader {
+	char magic[8];
+	uint32_t version, count_objects, count_polygons, count_lights;
+	float cam_position[3], cam_direction[3], cam_horizont[3];
+	uint32_t padding;
+	uint64_t objects_offset, polygons_offset, lights_offset, strings_offset, strings_size;
+};
+
+
+struct SceneObjectRecord {
+	uint32_t flags, max_count_models, count_instances, first_polygon, count_polygons;
+	float border_width, border_color[3], center[3];
+	uint64_t instances_offset;
+};
+
+
+struct ScenePolygonRecord {
+	uint32_t count_points, count_indices, light;
+	float shininess, alpha, ambient[3], diffuse[3], specular[3], emission[3];
+	int32_t textures[3];
+	uint32_t texture_gamma, vertex_format;
+	uint64_t vertices_offset, indices_offset;
+};
+
+
+struct SceneLightRecord {
+	int32_t type;
+	float ambient[3], diffuse[3], specular[3], position[3], direction[3], proxy_color[3];
+	float constant, linear, quadratic, cut_in, cut_out;
+};
+
+
+void write_vect3(float* destination, Vect3 value) {
+	destination[0] = value.x;
+	destination[1] = value.y;
+	destination[2] = value.z;
+}
+
+
+Vect3 read_vect3(const float* source) {
+	return Vect3(source[0], source[1], source[2]);
+}
+
+
+class SceneFileWriter {
+	std::vector < char > data;
+	std::vector < SceneObjectRecord > objects;
+	std::vector < ScenePolygonRecord > polygons;
+	std::vector < SceneLightRecord > lights;
+	std::vector < char > strings;
+	std::map < std::string, int32_t > string_offsets;
+	SceneFileHeader header;
+
+	uint64_t append(const void* source, uint64_t size) {
+		uint64_t offset = (data.size() + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+		data.resize(offset + size);
+		if (size > 0)
+			memcpy(data.data() + offset, source, size);
+		return offset;
+	}
+
+	int32_t add_string(std::string value) {
+		if (value.empty())
+			return -1;
+		if (string_offsets.count(value))
+			return string_offsets[value];
+
+		int32_t offset = strings.size();
+		uint32_t size = value.size();
+		strings.insert(strings.end(), (char*)&size, (char*)&size + sizeof(size));
+		strings.insert(strings.end(), value.begin(), value.end());
+		string_offsets[value] = offset;
+		return offset;
+	}
+
+	int32_t add_texture(Texture& texture, int slot, uint32_t& texture_gamma) {
+		if (texture.texture_id == 0)
+			return -1;
+
+		texture_gamma |= (uint32_t)texture.get_gamma() << slot;
+		return add_string(texture.get_path());
+	}
+
+public:
+	SceneFileWriter() {
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+		header.version = SCENE_FILE_VERSION;
+		data.resize(sizeof(SceneFileHeader));
+	}
+
+	void set_camera(Vect3 position, Vect3 direction, Vect3 horizont) {
+		write_vect3(header.cam_position, position);
+		write_vect3(header.cam_direction, direction);
+		write_vect3(header.cam_horizont, horizont);
+	}
+
+	void add_object(GraphObject& object) {
+		SceneObjectRecord record;
+		memset(&record, 0, sizeof(record));
+		record.flags = (object.border ? SCENE_OBJECT_BORDER : 0) | (object.transparent ? SCENE_OBJECT_TRANSPARENT : 0);
+		record.max_count_models = object.get_max_count_models();
+		record.border_width = object.border_width;
+		write_vect3(record.border_color, object.get_border_color());
+		write_vect3(record.center, object.get_center());
+
+		const std::vector < float >& rows = object.get_instance_rows();
+		record.count_instances = rows.size() / INSTANCE_SIZE;
+		record.instances_offset = append(rows.data(), sizeof(float) * rows.size());
+
+		record.first_polygon = polygons.size();
+		for (Polygon& polygon : object.get_polygons()) {
+			ScenePolygonRecord polygon_record;
+			memset(&polygon_record, 0, sizeof(polygon_record));
+
+			Material& material = polygon.material;
+			polygon_record.light = material.light;
+			polygon_record.shininess = material.shininess;
+			polygon_record.alpha = material.alpha;
+			write_vect3(polygon_record.ambient, material.ambient);
+			write_vect3(polygon_record.diffuse, material.diffuse);
+			write_vect3(polygon_record.specular, material.specular);
+			write_vect3(polygon_record.emission, material.emission);
+
+			polygon_record.textures[0] = add_texture(polygon.diffuse_map, 0, polygon_record.texture_gamma);
+			polygon_record.textures[1] = add_texture(polygon.specular_map, 1, polygon_record.texture_gamma);
+			polygon_record.textures[2] = add_texture(polygon.emission_map, 2, polygon_record.texture_gamma);
+
+			std::vector < float > vertices = polygon.get_vertices();
+			std::vector < unsigned int > indices = polygon.get_indices();
+			polygon_record.count_points = polygon.get_count_points();
+			polygon_record.vertex_format = polygon.get_vertex_format();
+			polygon_record.count_indices = indices.size();
+			polygon_record.vertices_offset = append(vertices.data(), sizeof(float) * vertices.size());
+			polygon_record.indices_offset = append(indices.data(), sizeof(unsigned int) * indices.size());
+			polygons.push_back(polygon_record);
+		}
+		record.count_polygons = polygons.size() - record.first_polygon;
+		objects.push_back(record);
+	}
+
+	void add_light(Light* light) {
+		SceneLightRecord record;
+		memset(&record, 0, sizeof(record));
+		record.type = SCENE_LIGHT_NONE;
+
+		if (light != nullptr) {
+			write_vect3(record.ambient, light->ambient);
+			write_vect3(record.diffuse, light->diffuse);
+			write_vect3(record.specular, light->specular);
+			write_vect3(record.proxy_color, light->proxy_color);
+		}
+
+		if (DirLight* dir_light = dynamic_cast < DirLight* >(light)) {
+			record.type = SCENE_LIGHT_DIR;
+			write_vect3(record.direction, dir_light->dir);
+		}
+		else if (PointLight* point_light = dynamic_cast < PointLight* >(light)) {
+			record.type = SCENE_LIGHT_POINT;
+			write_vect3(record.position, point_light->get_position());
+			record.constant = point_light->constant;
+			record.linear = point_light->linear;
+			record.quadratic = point_light->quadratic;
+		}
+		else if (SpotLight* spot_light = dynamic_cast < SpotLight* >(light)) {
+			record.type = SCENE_LIGHT_SPOT;
+			write_vect3(record.position, spot_light->get_position());
+			write_vect3(record.direction, spot_light->dir);
+			record.constant = spot_light->constant;
+			record.linear = spot_light->linear;
+			record.quadratic = spot_light->quadratic;
+			record.cut_in = spot_light->cut_in;
+			record.cut_out = spot_light->cut_out;
+		}
+		lights.push_back(record);
+	}
+
+	bool save(std::string path) {
+		header.count_objects = objects.size();
+		header.count_polygons = polygons.size();
+		header.count_lights = lights.size();
+		header.objects_offset = append(objects.data(), sizeof(SceneObjectRecord) * objects.size());
+		header.polygons_offset = append(polygons.data(), sizeof(ScenePolygonRecord) * polygons.size());
+		header.lights_offset = append(lights.data(), sizeof(SceneLightRecord) * lights.size());
+		header.strings_offset = append(strings.data(), strings.size());
+		header.strings_size = strings.size();
+		memcpy(data.data(), &header, sizeof(header));
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "ERROR::SCENE_FILE_WRITER::SAVE\nFailed to open " << path << ".\n";
+			return false;
+		}
+
+		file.write(data.data(), data.size());
+		return file.good();
+	}
+};
+
+
+class SceneFile {
+	const char* data = nullptr;
+	uint64_t size = 0;
+#ifdef _WIN32
+	std::vector < char > buffer;
+#endif
+
+	bool check_block(uint64_t offset, uint64_t block_size) {
+		return offset <= size && block_size <= size - offset;
+	}
+
+	bool validate() {
+		if (size < sizeof(SceneFileHeader) || memcmp(get_header().magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) != 0) {
+			std::cout << "ERROR::SCENE_FILE::OPEN\nNot a scene file.\n";
+			return false;
+		}
+
+		const SceneFileHeader& header = get_header();
+		if (header.version != SCENE_FILE_VERSION) {
+			std::cout << "ERROR::SCENE_FILE::OPEN\nUnsupported version " << header.version << ".\n";
+			return false;
+		}
+
+		bool valid = check_block(header.objects_offset, sizeof(SceneObjectRecord) * (uint64_t)header.count_objects)
+			&& check_block(header.polygons_offset, sizeof(ScenePolygonRecord) * (uint64_t)header.count_polygons)
+			&& check_block(header.lights_offset, sizeof(SceneLightRecord) * (uint64_t)header.count_lights)
+			&& check_block(header.strings_offset, header.strings_size);
+		for (uint32_t i = 0; valid && i < header.count_objects; i++) {
+			const SceneObjectRecord& object = get_object(i);
+			valid = check_block(object.instances_offset, sizeof(float) * INSTANCE_SIZE * (uint64_t)object.count_instances)
+				&& (uint64_t)object.first_polygon + object.count_polygons <= header.count_polygons
+				&& object.count_instances <= object.max_count_models
+				&& object.max_count_models <= SCENE_FILE_MAX_MODELS;
+		}
+		for (uint32_t i = 0; valid && i < header.count_polygons; i++) {
+			const ScenePolygonRecord& polygon = get_polygon(i);
+			valid = check_block(polygon.vertices_offset, sizeof(float) * 8 * (uint64_t)polygon.count_points)
+				&& check_block(polygon.indices_offset, sizeof(unsigned int) * (uint64_t)polygon.count_indices)
+				&& polygon.vertex_format <= VERTEX_FORMAT_PACKED;
+
+			const unsigned int* indices = get_indices(polygon);
+			for (uint32_t j = 0; valid && j < polygon.count_indices; j++)
+				valid = indices[j] < polygon.count_points;
+		}
+
+		if (!valid)
+			std::cout << "ERROR::SCENE_FILE::OPEN\nCorrupted scene file.\n";
+		return valid;
+	}
+
+public:
+	SceneFile() {
+	}
+
+	SceneFile(const SceneFile& other) = delete;
+
+	SceneFile& operator =(const SceneFile& other) = delete;
+
+	bool open(std::string path) {
+		close();
+
+#ifdef _WIN32
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "ERROR::SCENE_FILE::OPEN\nFailed to open " << path << ".\n";
+			return false;
+		}
+		buffer.assign(std::istreambuf_iterator < char >(file), std::istreambuf_iterator < char >());
+		data = buffer.data();
+		size = buffer.size();
+#else
+		int descriptor = ::open(path.c_str(), O_RDONLY);
+		struct stat status;
+		if (descriptor < 0 || fstat(descriptor, &status) != 0 || status.st_size == 0) {
+			std::cout << "ERROR::SCENE_FILE::OPEN\nFailed to open " << path << ".\n";
+			if (descriptor >= 0)
+				::close(descriptor);
+			return false;
+		}
+
+		void* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		::close(descriptor);
+		if (mapping == MAP_FAILED) {
+			std::cout << "ERROR::SCENE_FILE::OPEN\nFailed to map " << path << ".\n";
+			return false;
+		}
+		data = (const char*)mapping;
+		size = status.st_size;
+#endif
+
+		if (!validate()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	const SceneFileHeader& get_header() {
+		return *(const SceneFileHeader*)data;
+	}
+
+	const SceneObjectRecord& get_object(int id) {
+		return ((const SceneObjectRecord*)(data + get_header().objects_offset))[id];
+	}
+
+	const ScenePolygonRecord& get_polygon(int id) {
+		return ((const ScenePolygonRecord*)(data + get_header().polygons_offset))[id];
+	}
+
+	const SceneLightRecord& get_light(int id) {
+		return ((const SceneLightRecord*)(data + get_header().lights_offset))[id];
+	}
+
+	const float* get_instances(const SceneObjectRecord& object) {
+		return (const float*)(data + object.instances_offset);
+	}
+
+	const float* get_vertices(const ScenePolygonRecord& polygon) {
+		return (const float*)(data + polygon.vertices_offset);
+	}
+
+	const unsigned int* get_indices(const ScenePolygonRecord& polygon) {
+		return (const unsigned int*)(data + polygon.indices_offset);
+	}
+
+	std::string get_string(int32_t offset) {
+		const SceneFileHeader& header = get_header();
+		if (offset < 0 || offset + sizeof(uint32_t) > header.strings_size)
+			return "";
+
+		uint32_t length;
+		memcpy(&length, data + header.strings_offset + offset, sizeof(length));
+		if (offset + sizeof(uint32_t) + length > header.strings_size)
+			return "";
+		return std::string(data + header.strings_offset + offset + sizeof(uint32_t), length);
+	}
+
+	void read_object(int id, GraphObject& object, std::map < std::string, Texture >& textures) {
+		const SceneObjectRecord& record = get_object(id);
+		object.border = record.flags & SCENE_OBJECT_BORDER;
+		object.transparent = record.flags & SCENE_OBJECT_TRANSPARENT;
+		object.border_width = record.border_width;
+		object.set_border_color(read_vect3(record.border_color));
+
+		object.reserve_polygons(record.count_polygons);
+		for (uint32_t i = record.first_polygon; i < record.first_polygon + record.count_polygons; i++) {
+			const ScenePolygonRecord& polygon_record = get_polygon(i);
+			Polygon& polygon = object.emplace_polygon(polygon_record.count_points);
+			polygon.set_vertex_format(polygon_record.vertex_format);
+			polygon.load_vertices(get_vertices(polygon_record), get_indices(polygon_record), polygon_record.count_indices);
+
+			polygon.material.light = polygon_record.light;
+			polygon.material.shininess = polygon_record.shininess;
+			polygon.material.alpha = polygon_record.alpha;
+			polygon.material.ambient = read_vect3(polygon_record.ambient);
+			polygon.material.diffuse = read_vect3(polygon_record.diffuse);
+			polygon.material.specular = read_vect3(polygon_record.specular);
+			polygon.material.emission = read_vect3(polygon_record.emission);
+
+			Texture* maps[3] = { &polygon.diffuse_map, &polygon.specular_map, &polygon.emission_map };
+			for (int j = 0; j < 3; j++) {
+				std::string path = get_string(polygon_record.textures[j]);
+				if (path.empty())
+					continue;
+
+				bool gamma = (polygon_record.texture_gamma >> j) & 1;
+				std::string key = path + (gamma ? "#srgb" : "#linear");
+				if (!textures.count(key))
+					textures[key] = Texture(path, gamma);
+				*maps[j] = textures[key];
+			}
+		}
+
+		object.set_center(read_vect3(record.center));
+		object.load_instances(get_instances(record), record.count_instances);
+	}
+
+	Light* create_light(int id) {
+		const SceneLightRecord& record = get_light(id);
+		Light* light = nullptr;
+		if (record.type == SCENE_LIGHT_DIR) {
+			light = new DirLight(read_vect3(record.direction));
+		}
+		else if (record.type == SCENE_LIGHT_POINT) {
+			PointLight* point_light = new PointLight(read_vect3(record.position));
+			point_light->constant = record.constant;
+			point_light->linear = record.linear;
+			point_light->quadratic = record.quadratic;
+			light = point_light;
+		}
+		else if (record.type == SCENE_LIGHT_SPOT) {
+			SpotLight* spot_light = new SpotLight(read_vect3(record.position), read_vect3(record.direction), record.cut_in, record.cut_out);
+			spot_light->constant = record.constant;
+			spot_light->linear = record.linear;
+			spot_light->quadratic = record.quadratic;
+			light = spot_light;
+		}
+
+		if (light != nullptr) {
+			light->ambient = read_vect3(record.ambient);
+			light->diffuse = read_vect3(record.diffuse);
+			light->specular = read_vect3(record.specular);
+			light->proxy_color = read_vect3(record.proxy_color);
+		}
+		return light;
+	}
+
+	void close() {
+#ifdef _WIN32
+		buffer.clear();
+#else
+		if (data != nullptr)
+			munmap((void*)data, size);
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	~SceneFile() {
+		close();
+	}
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "CommonClasses/Matrix.h"
+#include "CommonClasses/VectorMath.h"
+
+
+const int SCENE_INSTANCE = 0;
+const int SCENE_NODE = 1;
+const int SCENE_CAMERA = 2;
+
+
+template < typename T >
+class CommandQueue {
+	struct Node {
+		std::atomic < Node* > next;
+		T value;
+	};
+
+	alignas(64) std::atomic < Node* > head;
+	alignas(64) Node* tail;
+
+public:
+	CommandQueue() {
+		tail = new Node();
+		tail->next.store(nullptr, std::memory_order_relaxed);
+		head.store(tail, std::memory_order_relaxed);
+	}
+
+	CommandQueue(const CommandQueue& other) = delete;
+
+	CommandQueue& operator =(const CommandQueue& other) = delete;
+
+	void push(const T& value) {
+		Node* node = new Node();
+		node->value = value;
+		node->next.store(nullptr, std::memory_order_relaxed);
+
+		Node* prev = head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	bool pop(T& value) {
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+			return false;
+
+		value = next->value;
+		delete tail;
+		tail = next;
+		return true;
+	}
+
+	~CommandQueue() {
+		T value;
+		while (pop(value)) {}
+		delete tail;
+	}
+};
+
+
+template < typename T >
+class TripleBuffer {
+	static const int FRESH = 4;
+
+	T slots[3];
+	int write_index = 0, read_index = 1;
+	alignas(64) std::atomic < int > middle_index;
+
+public:
+	TripleBuffer() {
+		middle_index.store(2, std::memory_order_relaxed);
+	}
+
+	TripleBuffer(const TripleBuffer& other) = delete;
+
+	TripleBuffer& operator =(const TripleBuffer& other) = delete;
+
+	T& get_write() {
+		return slots[write_index];
+	}
+
+	void publish() {
+		write_index = middle_index.exchange(write_index | FRESH, std::memory_order_acq_rel) & 3;
+	}
+
+	bool update() {
+		if (!(middle_index.load(std::memory_order_relaxed) & FRESH))
+			return false;
+
+		read_index = middle_index.exchange(read_index, std::memory_order_acq_rel) & 3;
+		return true;
+	}
+
+	const T& get_read() {
+		return slots[read_index];
+	}
+};
+
+
+struct SceneCommand {
+	int type = SCENE_INSTANCE, id = -1, instance_id = 0;
+	mat4 matrix;
+};
+
+
+struct SceneSnapshot {
+	unsigned int version = 0, camera_version = 0;
+	vec3 cam_position = { 0, 0, 0 }, cam_direction = { 0, 0, 1 }, cam_horizont = { 1, 0, 0 };
+
+	std::vector < int > types, ids, instance_ids;
+	std::vector < unsigned int > versions;
+	std::vector < mat4 > matrices;
+
+	int size() const {
+		return types.size();
+	}
+
+	void copy_changes(const SceneSnapshot& source) {
+		for (int i = size(); i < source.size(); i++) {
+			types.push_back(source.types[i]);
+			ids.push_back(source.ids[i]);
+			instance_ids.push_back(source.instance_ids[i]);
+			versions.push_back(0);
+			matrices.push_back(source.matrices[i]);
+		}
+
+		for (int i = 0; i < source.size(); i++) {
+			if (source.versions[i] <= version)
+				continue;
+
+			versions[i] = source.versions[i];
+			matrices[i] = source.matrices[i];
+		}
+
+		if (source.camera_version > version) {
+			camera_version = source.camera_version;
+			cam_position = source.cam_position;
+			cam_direction = source.cam_direction;
+			cam_horizont = source.cam_horizont;
+		}
+		version = source.version;
+	}
+};
+
+
+class SceneFrontend {
+	CommandQueue < SceneCommand > commands;
+	TripleBuffer < SceneSnapshot > snapshots;
+	SceneSnapshot state;
+	std::map < std::tuple < int, int, int >, int > entries;
+
+	void apply(const SceneCommand& command, unsigned int version) {
+		if (command.type == SCENE_CAMERA) {
+			state.cam_position = { command.matrix.m[0], command.matrix.m[1], command.matrix.m[2] };
+			state.cam_direction = { command.matrix.m[4], command.matrix.m[5], command.matrix.m[6] };
+			state.cam_horizont = { command.matrix.m[8], command.matrix.m[9], command.matrix.m[10] };
+			state.camera_version = version;
+			return;
+		}
+
+		std::tuple < int, int, int > key = { command.type, command.id, command.instance_id };
+		std::map < std::tuple < int, int, int >, int >::iterator entry = entries.find(key);
+		if (entry == entries.end()) {
+			entry = entries.insert({ key, state.size() }).first;
+			state.types.push_back(command.type);
+			state.ids.push_back(command.id);
+			state.instance_ids.push_back(command.instance_id);
+			state.versions.push_back(0);
+			state.matrices.push_back(command.matrix);
+		}
+
+		state.versions[entry->second] = version;
+		state.matrices[entry->second] = command.matrix;
+	}
+
+public:
+	void set_matrix(int object_id, Matrix matrix, int instance_id = 0) {
+		SceneCommand command;
+		command.type = SCENE_INSTANCE;
+		command.id = object_id;
+		command.instance_id = instance_id;
+		command.matrix = matrix.get_mat4();
+		commands.push(command);
+	}
+
+	void set_node_local(int node, Matrix local) {
+		SceneCommand command;
+		command.type = SCENE_NODE;
+		command.id = node;
+		command.matrix = local.get_mat4();
+		commands.push(command);
+	}
+
+	void set_camera(Vect3 position, Vect3 direction, Vect3 horizont) {
+		SceneCommand command;
+		command.type = SCENE_CAMERA;
+		command.matrix = {
+			(float)position.x, (float)position.y, (float)position.z, 0,
+			(float)direction.x, (float)direction.y, (float)direction.z, 0,
+			(float)horizont.x, (float)horizont.y, (float)horizont.z, 0,
+			0, 0, 0, 1
+		};
+		commands.push(command);
+	}
+
+	bool publish() {
+		unsigned int version = state.version + 1;
+		bool changed = false;
+
+		SceneCommand command;
+		while (commands.pop(command)) {
+			apply(command, version);
+			changed = true;
+		}
+		if (!changed)
+			return false;
+
+		state.version = version;
+		snapshots.get_write().copy_changes(state);
+		snapshots.publish();
+		return true;
+	}
+
+	const SceneSnapshot& acquire() {
+		snapshots.update();
+		return snapshots.get_read();
+	}
+};
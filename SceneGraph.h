@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CommonClasses/Matrix.h"
+#include "CommonClasses/VectorMath.h"
+#include "WorkerPool.h"
+
+
+struct SceneNodeTarget {
+	int node, object_id, instance_id;
+};
+
+
+class SceneGraph {
+	int count_threads = 1, min_parallel_nodes = 4096;
+	bool levels_dirty = false, any_dirty = false;
+
+	std::vector < int > parents, depths, object_ids, instance_ids, free_nodes;
+	std::vector < char > alive, dirty;
+	std::vector < mat4 > locals, worlds;
+	std::vector < std::vector < int > > levels;
+	std::vector < SceneNodeTarget > changed;
+	std::unique_ptr < WorkerPool > workers;
+
+	bool check_node(int id, std::string method) {
+		if (0 <= id && id < alive.size() && alive[id])
+			return true;
+
+		std::cout << "ERROR::SCENE_GRAPH::" << method << "\nNode with id " << id << " not found.\n";
+		return false;
+	}
+
+	int get_depth(int id) {
+		if (depths[id] >= 0)
+			return depths[id];
+
+		std::vector < int > path;
+		for (; id >= 0 && depths[id] < 0; id = parents[id])
+			path.push_back(id);
+
+		int depth = id >= 0 ? depths[id] : -1;
+		for (int i = path.size() - 1; i >= 0; i--)
+			depths[path[i]] = ++depth;
+		return depth;
+	}
+
+	void update_levels() {
+		std::fill(depths.begin(), depths.end(), -1);
+		levels.clear();
+		for (int id = 0; id < alive.size(); id++) {
+			if (!alive[id])
+				continue;
+
+			int depth = get_depth(id);
+			if (depth >= levels.size())
+				levels.resize(depth + 1);
+			levels[depth].push_back(id);
+		}
+		levels_dirty = false;
+	}
+
+	void update_nodes(const std::vector < int >& level, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int id = level[i], parent = parents[id];
+			if (parent < 0) {
+				if (dirty[id])
+					worlds[id] = locals[id];
+				continue;
+			}
+
+			if (dirty[parent]) {
+				dirty[id] = true;
+				worlds[id] = worlds[parent] * locals[id];
+			}
+			else if (dirty[id]) {
+				worlds[id] = worlds[parent] * locals[id];
+			}
+		}
+	}
+
+	void update_level(const std::vector < int >& level) {
+		int count = std::min(count_threads, (int)level.size() / std::max(min_parallel_nodes, 1));
+		if (count <= 1) {
+			update_nodes(level, 0, level.size());
+			return;
+		}
+
+		if (workers == nullptr)
+			workers.reset(new WorkerPool(count_threads - 1));
+
+		int step = (level.size() + count - 1) / count;
+		workers->run(count, [&](int index) {
+			update_nodes(level, index * step, std::min((index + 1) * step, (int)level.size()));
+		});
+	}
+
+	void mark_dirty(int id) {
+		dirty[id] = true;
+		any_dirty = true;
+	}
+
+public:
+	SceneGraph() {
+		set_count_threads(std::thread::hardware_concurrency());
+	}
+
+	SceneGraph(const SceneGraph& other) {
+		*this = other;
+	}
+
+	SceneGraph& operator =(const SceneGraph& other) {
+		count_threads = other.count_threads;
+		min_parallel_nodes = other.min_parallel_nodes;
+		levels_dirty = other.levels_dirty;
+		any_dirty = other.any_dirty;
+		parents = other.parents;
+		depths = other.depths;
+		object_ids = other.object_ids;
+		instance_ids = other.instance_ids;
+		free_nodes = other.free_nodes;
+		alive = other.alive;
+		dirty = other.dirty;
+		locals = other.locals;
+		worlds = other.worlds;
+		levels = other.levels;
+		changed = other.changed;
+		workers.reset();
+		return *this;
+	}
+
+	void set_count_threads(int count_threads) {
+		count_threads = std::max(count_threads, 1);
+		if (count_threads != this->count_threads)
+			workers.reset();
+		this->count_threads = count_threads;
+	}
+
+	void set_min_parallel_nodes(int min_parallel_nodes) {
+		this->min_parallel_nodes = std::max(min_parallel_nodes, 1);
+	}
+
+	int add_node(Matrix local = one_matrix(4), int parent = -1) {
+		if (parent >= 0 && !check_node(parent, "ADD_NODE"))
+			parent = -1;
+
+		int id;
+		if (free_nodes.empty()) {
+			id = alive.size();
+			parents.push_back(parent);
+			depths.push_back(-1);
+			object_ids.push_back(-1);
+			instance_ids.push_back(-1);
+			alive.push_back(true);
+			dirty.push_back(true);
+			locals.push_back(local.get_mat4());
+			worlds.push_back(local.get_mat4());
+		}
+		else {
+			id = free_nodes.back();
+			free_nodes.pop_back();
+			parents[id] = parent;
+			object_ids[id] = -1;
+			instance_ids[id] = -1;
+			alive[id] = true;
+			locals[id] = local.get_mat4();
+		}
+
+		mark_dirty(id);
+		levels_dirty = true;
+		return id;
+	}
+
+	void delete_node(int id) {
+		if (!check_node(id, "DELETE_NODE"))
+			return;
+
+		if (levels_dirty)
+			update_levels();
+
+		std::vector < char > removed(alive.size(), false);
+		removed[id] = true;
+		for (int depth = depths[id] + 1; depth < levels.size(); depth++) {
+			for (int node : levels[depth])
+				removed[node] = removed[parents[node]];
+		}
+
+		for (int node = 0; node < alive.size(); node++) {
+			if (!removed[node])
+				continue;
+
+			alive[node] = false;
+			dirty[node] = false;
+			parents[node] = -1;
+			free_nodes.push_back(node);
+		}
+		levels_dirty = true;
+	}
+
+	void set_parent(int id, int parent) {
+		if (!check_node(id, "SET_PARENT") || (parent >= 0 && !check_node(parent, "SET_PARENT")))
+			return;
+
+		for (int node = parent; node >= 0; node = parents[node]) {
+			if (node == id) {
+				std::cout << "ERROR::SCENE_GRAPH::SET_PARENT\nNode " << parent << " is a descendant of node " << id << ".\n";
+				return;
+			}
+		}
+
+		parents[id] = parent;
+		mark_dirty(id);
+		levels_dirty = true;
+	}
+
+	void set_local(int id, Matrix local) {
+		if (!check_node(id, "SET_LOCAL"))
+			return;
+
+		locals[id] = local.get_mat4();
+		mark_dirty(id);
+	}
+
+	void change_local(int id, Matrix trans) {
+		if (!check_node(id, "CHANGE_LOCAL"))
+			return;
+
+		locals[id] = trans.get_mat4() * locals[id];
+		mark_dirty(id);
+	}
+
+	void attach_object(int id, int object_id, int instance_id = 0) {
+		if (!check_node(id, "ATTACH_OBJECT"))
+			return;
+
+		object_ids[id] = object_id;
+		instance_ids[id] = instance_id;
+		mark_dirty(id);
+	}
+
+	void detach_object(int id) {
+		if (!check_node(id, "DETACH_OBJECT"))
+			return;
+
+		object_ids[id] = -1;
+		instance_ids[id] = -1;
+	}
+
+	int get_parent(int id) {
+		if (!check_node(id, "GET_PARENT"))
+			return -1;
+		return parents[id];
+	}
+
+	Matrix get_local(int id) {
+		if (!check_node(id, "GET_LOCAL"))
+			return one_matrix(4);
+		return Matrix(locals[id]);
+	}
+
+	Matrix get_world(int id) {
+		if (!check_node(id, "GET_WORLD"))
+			return one_matrix(4);
+
+		update();
+		return Matrix(worlds[id]);
+	}
+
+	int get_count_nodes() {
+		return alive.size() - free_nodes.size();
+	}
+
+	void update() {
+		if (levels_dirty)
+			update_levels();
+		if (!any_dirty)
+			return;
+
+		for (const std::vector < int >& level : levels)
+			update_level(level);
+
+		for (int id = 0; id < dirty.size(); id++) {
+			if (!dirty[id])
+				continue;
+
+			dirty[id] = false;
+			if (object_ids[id] >= 0)
+				changed.push_back({ id, object_ids[id], instance_ids[id] });
+		}
+		any_dirty = false;
+	}
+
+	void take_changed(std::vector < SceneNodeTarget >& targets) {
+		update();
+		targets.swap(changed);
+		changed.clear();
+	}
+};
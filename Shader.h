@@ -6,10 +6,11 @@
 #include <vector>
 #include <algorithm>
 #include <GL/glew.h>
+#include "GLState.h"
 
 
 class Shader {
-	std::string vertex_shader_code, fragment_shader_code;
+	std::string vertex_shader_code, fragment_shader_code, compute_shader_code;
 
 	unsigned int load_vertex_shader(std::string vertex_shader_path) {
 		std::ifstream vertex_shader_file(vertex_shader_path + ".vert_sh");
@@ -59,10 +60,34 @@ class Shader {
 		return fragment_shader;
 	}
 
-	void link_shaders(unsigned int vertex_shader, unsigned int fragment_shader) {
+	unsigned int load_compute_shader(std::string compute_shader_path) {
+		std::ifstream compute_shader_file(compute_shader_path + ".comp_sh");
+
+		for (std::string line; std::getline(compute_shader_file, line); )
+			compute_shader_code += line + "\n";
+
+		const char* compute_shader_code_c = compute_shader_code.c_str();
+
+		unsigned int compute_shader = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(compute_shader, 1, &compute_shader_code_c, NULL);
+		glCompileShader(compute_shader);
+
+		int success;
+		glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			char info_log[512];
+			glGetShaderInfoLog(compute_shader, 512, NULL, info_log);
+
+			std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << info_log << "\n";
+		}
+
+		return compute_shader;
+	}
+
+	void link_shaders(std::vector < unsigned int > shaders) {
 		program = glCreateProgram();
-		glAttachShader(program, vertex_shader);
-		glAttachShader(program, fragment_shader);
+		for (unsigned int shader : shaders)
+			glAttachShader(program, shader);
 		glLinkProgram(program);
 
 		int success;
@@ -85,13 +110,19 @@ public:
 	Shader(std::string vertex_shader_path, std::string fragment_shader_path) {
 		unsigned int vertex_shader = load_vertex_shader(vertex_shader_path);
 		unsigned int fragment_shader = load_fragment_shader(fragment_shader_path);
-		link_shaders(vertex_shader, fragment_shader);
+		link_shaders({ vertex_shader, fragment_shader });
 		glDeleteShader(vertex_shader);
 		glDeleteShader(fragment_shader);
 	}
 
+	explicit Shader(std::string compute_shader_path) {
+		unsigned int compute_shader = load_compute_shader(compute_shader_path);
+		link_shaders({ compute_shader });
+		glDeleteShader(compute_shader);
+	}
+
 	void use() {
-		glUseProgram(program);
+		gl_state.use_program(program);
 	}
 
 	int get_count_lights() {
@@ -5,10 +5,12 @@
 #include <string>
 #include <GL/glew.h>
 #include <SFML/Graphics.hpp>
+#include "GLState.h"
 
 
 class Texture {
 	bool gamma;
+	std::string path;
 	sf::Image image;
 
 public:
@@ -20,11 +22,12 @@ public:
 
 	Texture(std::string texture_path, bool gamma = true) {
 		this->gamma = gamma;
+		path = texture_path;
 		if (!image.loadFromFile(texture_path))
 			std::cout << "ERROR::TEXTURE::LOAD_FAILED\n";
 
 		glGenTextures(1, &texture_id);
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+		gl_state.bind_texture(GL_TEXTURE_2D, texture_id);
 
 		if (gamma)
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, image.getSize().x, image.getSize().y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.getPixelsPtr());
@@ -34,19 +37,24 @@ public:
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
 	Texture set_wrapping(int wrapping) {
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+		gl_state.bind_texture(GL_TEXTURE_2D, texture_id);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapping);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapping);
-		glBindTexture(GL_TEXTURE_2D, 0);
 
 		return *this;
 	}
 
+	std::string get_path() {
+		return path;
+	}
+
+	bool get_gamma() {
+		return gamma;
+	}
+
 	int get_min_alpha() {
 		int res = 255;
 		for (int i = 0; i < image.getSize().x; i++) {
@@ -61,15 +69,13 @@ public:
 		if (!texture_id)
 			return;
 
-		glActiveTexture(GL_TEXTURE0 + id);
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+		gl_state.bind_texture_unit(id, GL_TEXTURE_2D, texture_id);
 	}
 
 	void deactive(int id) {
 		if (!texture_id)
 			return;
 
-		glActiveTexture(GL_TEXTURE0 + id);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		gl_state.bind_texture_unit(id, GL_TEXTURE_2D, 0);
 	}
 };
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkerPool {
+	bool stopping = false;
+	int generation = 0, count_tasks = 0, next_task = 0, count_done = 0;
+	std::function < void(int) > task;
+	std::vector < std::thread > threads;
+	std::mutex mutex;
+	std::condition_variable condition, done_condition;
+
+	void run_tasks() {
+		while (true) {
+			int index;
+			{
+				std::lock_guard < std::mutex > lock(mutex);
+				if (next_task >= count_tasks)
+					return;
+				index = next_task++;
+			}
+
+			task(index);
+
+			std::lock_guard < std::mutex > lock(mutex);
+			if (++count_done == count_tasks)
+				done_condition.notify_all();
+		}
+	}
+
+	void work() {
+		int seen = 0;
+		while (true) {
+			{
+				std::unique_lock < std::mutex > lock(mutex);
+				condition.wait(lock, [&]() { return stopping || generation != seen; });
+				if (stopping)
+					return;
+				seen = generation;
+			}
+			run_tasks();
+		}
+	}
+
+public:
+	WorkerPool(int count_threads) {
+		for (int i = 0; i < count_threads; i++)
+			threads.push_back(std::thread(&WorkerPool::work, this));
+	}
+
+	WorkerPool(const WorkerPool& other) = delete;
+
+	WorkerPool& operator =(const WorkerPool& other) = delete;
+
+	int get_count_threads() {
+		return threads.size();
+	}
+
+	void run(int count_tasks, std::function < void(int) > task) {
+		{
+			std::lock_guard < std::mutex > lock(mutex);
+			this->task = task;
+			this->count_tasks = count_tasks;
+			next_task = 0;
+			count_done = 0;
+			generation++;
+		}
+		condition.notify_all();
+		run_tasks();
+
+		std::unique_lock < std::mutex > lock(mutex);
+		done_condition.wait(lock, [&]() { return count_done == this->count_tasks; });
+	}
+
+	~WorkerPool() {
+		{
+			std::lock_guard < std::mutex > lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+};